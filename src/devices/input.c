@@ -41,6 +41,43 @@ input_getc (void)
   return key;
 }
 
+/* Reads up to SIZE keys from the input buffer into BUF and
+   returns the number read.  Everything already buffered is taken
+   in one critical section, stopping after a carriage return or
+   new-line so that a line-oriented reader gets one line at a
+   time.  If the buffer is empty, waits for a key unless
+   NONBLOCKING is true, in which case 0 is returned. */
+size_t
+input_read (uint8_t *buf, size_t size, bool nonblocking) 
+{
+  enum intr_level old_level;
+  size_t cnt = 0;
+
+  if (size == 0)
+    return 0;
+
+  old_level = intr_disable ();
+  if (intq_empty (&buffer) && !nonblocking)
+    {
+      /* Sleep for the first key, then take whatever else came. */
+      buf[cnt++] = intq_getc (&buffer);
+      if (input_is_eol (buf[0]))
+        size = cnt;
+    }
+  cnt += intq_getn (&buffer, buf + cnt, size - cnt, "\r\n");
+  serial_notify ();
+  intr_set_level (old_level);
+
+  return cnt;
+}
+
+/* Returns true if KEY ends a line of input. */
+bool
+input_is_eol (uint8_t key) 
+{
+  return key == '\r' || key == '\n';
+}
+
 /* Returns true if the input buffer is full,
    false otherwise.
    Interrupts must be off. */
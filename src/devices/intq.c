@@ -1,5 +1,6 @@
 #include "devices/intq.h"
 #include <debug.h>
+#include <string.h>
 #include "threads/thread.h"
 
 static int next (int pos);
@@ -54,6 +55,30 @@ intq_getc (struct intq *q)
   return byte;
 }
 
+/* Removes up to SIZE bytes from Q into BUF and returns the
+   number removed.  Only bytes already in Q are taken, and any
+   byte found in the string STOP ends the read after it is
+   copied; STOP may be a null pointer to read until Q is empty or
+   SIZE bytes are taken.  Never sleeps. */
+size_t
+intq_getn (struct intq *q, uint8_t *buf, size_t size, const char *stop) 
+{
+  size_t cnt = 0;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  while (cnt < size && !intq_empty (q)) 
+    {
+      uint8_t byte = q->buf[q->tail];
+      q->tail = next (q->tail);
+      buf[cnt++] = byte;
+      if (stop != NULL && byte != '\0' && strchr (stop, byte) != NULL)
+        break;
+    }
+  if (cnt > 0)
+    signal (q, &q->not_full);
+  return cnt;
+}
+
 /* Adds BYTE to the end of Q.
    If Q is full, sleeps until a byte is removed.
    When called from an interrupt handler, Q must not be full. */
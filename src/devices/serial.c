@@ -1,7 +1,6 @@
 #include "devices/serial.h"
 #include <debug.h>
 #include "devices/input.h"
-#include "devices/intq.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
@@ -51,8 +50,20 @@
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
 
-/* Data to be transmitted. */
-static struct intq txq;
+/* Transmit ring size, in bytes.  Much bigger than an intq, so
+   that writers rarely have to wait for the UART. */
+#define TX_BUFSIZE 4096
+
+/* Data to be transmitted, a circular buffer shared with
+   serial_interrupt().  Interrupts must be off to touch it. */
+static uint8_t tx_buf[TX_BUFSIZE];
+static size_t tx_head;          /* New data is written here. */
+static size_t tx_tail;          /* Old data is read here. */
+static struct semaphore tx_not_full;  /* Writers waiting for room. */
+
+static bool tx_empty (void);
+static bool tx_full (void);
+static uint8_t tx_getc (void);
 
 static void set_serial (int bps);
 static void putc_poll (uint8_t);
@@ -71,7 +82,8 @@ init_poll (void)
   outb (FCR_REG, 0);                    /* Disable FIFO. */
   set_serial (9600);                    /* 9.6 kbps, N-8-1. */
   outb (MCR_REG, MCR_OUT2);             /* Required to enable interrupts. */
-  intq_init (&txq);
+  tx_head = tx_tail = 0;
+  sema_init (&tx_not_full, 0);
   mode = POLL;
 } 
 
@@ -110,20 +122,30 @@ serial_putc (uint8_t byte)
     }
   else 
     {
-      /* Otherwise, queue a byte and update the interrupt enable
-         register. */
-      if (old_level == INTR_OFF && intq_full (&txq)) 
+      /* Otherwise, queue a byte, and turn on the transmit
+         interrupt if the queue was empty. */
+      bool was_empty;
+
+      while (tx_full ())
         {
-          /* Interrupts are off and the transmit queue is full.
-             If we wanted to wait for the queue to empty,
-             we'd have to reenable interrupts.
-             That's impolite, so we'll send a character via
-             polling instead. */
-          putc_poll (intq_getc (&txq)); 
+          if (old_level == INTR_OFF || intr_context ())
+            {
+              /* Interrupts are off and the transmit queue is full.
+                 If we wanted to wait for the queue to empty,
+                 we'd have to reenable interrupts.
+                 That's impolite, so we'll send a character via
+                 polling instead. */
+              putc_poll (tx_getc ());
+            }
+          else
+            sema_down (&tx_not_full);
         }
 
-      intq_putc (&txq, byte); 
-      write_ier ();
+      was_empty = tx_empty ();
+      tx_buf[tx_head] = byte;
+      tx_head = (tx_head + 1) % TX_BUFSIZE;
+      if (was_empty)
+        write_ier ();
     }
   
   intr_set_level (old_level);
@@ -135,8 +157,8 @@ void
 serial_flush (void) 
 {
   enum intr_level old_level = intr_disable ();
-  while (!intq_empty (&txq))
-    putc_poll (intq_getc (&txq));
+  while (!tx_empty ())
+    putc_poll (tx_getc ());
   intr_set_level (old_level);
 }
 
@@ -182,7 +204,7 @@ write_ier (void)
 
   /* Enable transmit interrupt if we have any characters to
      transmit. */
-  if (!intq_empty (&txq))
+  if (!tx_empty ())
     ier |= IER_XMIT;
 
   /* Enable receive interrupt if we have room to store any
@@ -220,9 +242,43 @@ serial_interrupt (struct intr_frame *f UNUSED)
 
   /* As long as we have a byte to transmit, and the hardware is
      ready to accept a byte for transmission, transmit a byte. */
-  while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0) 
-    outb (THR_REG, intq_getc (&txq));
+  while (!tx_empty () && (inb (LSR_REG) & LSR_THRE) != 0) 
+    outb (THR_REG, tx_getc ());
+
+  /* Wake up writers waiting for room, they recheck it. */
+  if (!tx_full ())
+    while (!list_empty (&tx_not_full.waiters))
+      sema_up (&tx_not_full);
 
   /* Update interrupt enable register based on queue status. */
   write_ier ();
 }
+
+/* Returns true if the transmit queue is empty. */
+static bool
+tx_empty (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  return tx_head == tx_tail;
+}
+
+/* Returns true if the transmit queue is full. */
+static bool
+tx_full (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  return (tx_head + 1) % TX_BUFSIZE == tx_tail;
+}
+
+/* Removes and returns the oldest byte in the transmit queue,
+   which must not be empty. */
+static uint8_t
+tx_getc (void)
+{
+  uint8_t byte;
+
+  ASSERT (!tx_empty ());
+  byte = tx_buf[tx_tail];
+  tx_tail = (tx_tail + 1) % TX_BUFSIZE;
+  return byte;
+}
@@ -5,7 +5,8 @@
    Incidentally, another way to do this while avoiding the seeks
    would be to open the input file, then remove() it and reopen
    it under another handle.  Because of Unix deletion semantics
-   this works fine. */
+   this works fine.  Here positional reads and writes avoid them
+   instead. */
 
 #include <ctype.h>
 #include <stdio.h>
@@ -16,6 +17,7 @@ main (int argc, char *argv[])
 {
   char buf[1024];
   int handle;
+  unsigned ofs = 0;
 
   if (argc != 2)
     exit (1);
@@ -28,16 +30,16 @@ main (int argc, char *argv[])
     {
       int n, i;
 
-      n = read (handle, buf, sizeof buf);
+      n = pread (handle, buf, sizeof buf, ofs);
       if (n <= 0)
         break;
 
       for (i = 0; i < n; i++)
         buf[i] = toupper ((unsigned char) buf[i]);
 
-      seek (handle, tell (handle) - n);
-      if (write (handle, buf, n) != n)
+      if (pwrite (handle, buf, n, ofs) != n)
         printf ("write failed\n");
+      ofs += n;
     }
 
   close (handle);
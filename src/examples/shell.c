@@ -4,6 +4,7 @@
 #include <syscall.h>
 
 static void read_line (char line[], size_t);
+static char read_char (void);
 static bool backspace (char **pos, char line[]);
 
 int
@@ -54,12 +55,12 @@ read_line (char line[], size_t size)
   char *pos = line;
   for (;;)
     {
-      char c;
-      read (STDIN_FILENO, &c, 1);
+      char c = read_char ();
 
       switch (c) 
         {
         case '\r':
+        case '\n':
           *pos = '\0';
           putchar ('\n');
           return;
@@ -85,6 +86,23 @@ read_line (char line[], size_t size)
     }
 }
 
+/* Returns the next character of input.  The kernel hands back
+   everything typed up to the end of a line in one read, so input
+   is fetched a buffer at a time and handed out from here. */
+static char
+read_char (void) 
+{
+  static char buf[64];
+  static int pos, len;
+
+  while (pos >= len) 
+    {
+      len = read (STDIN_FILENO, buf, sizeof buf);
+      pos = 0;
+    }
+  return buf[pos++];
+}
+
 /* If *POS is past the beginning of LINE, backs up one character
    position.  Returns true if successful, false if nothing was
    done. */
@@ -421,6 +421,25 @@ static inline void clock_next(void) {
 }
 
 
+/* whether SECTOR is in the buffer cache and readable without disk
+ * I/O; a snapshot that never waits on an entry */
+bool cache_contains(block_sector_t sector) {
+	ASSERT (sector != INVALID_SECTOR_ID);
+	bool found = false;
+	lock_acquire(&buffer_cache_lock);
+	int i;
+	for (i = 0; i < CACHE_SIZE; i++) {
+		if (buffer_cache[i].sector_id == sector
+				&& !buffer_cache[i].loading_in
+				&& !buffer_cache[i].flushing_out) {
+			found = true;
+			break;
+		}
+	}
+	lock_release(&buffer_cache_lock);
+	return found;
+}
+
 /* cache read */
 off_t cache_read(block_sector_t sector, block_sector_t next_sector,
 		void *buffer, off_t sector_offset, off_t read_bytes) {
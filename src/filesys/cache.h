@@ -12,5 +12,6 @@ off_t cache_read(block_sector_t sector, block_sector_t next_sector,
 off_t cache_write(block_sector_t sector, void *buffer,
 		off_t sector_offset, off_t write_bytes);
 void force_flush_all_cache(void);
+bool cache_contains(block_sector_t sector);
 
 #endif
@@ -0,0 +1,181 @@
+#include "filesys/dcache.h"
+#include <stdbool.h>
+#include <hash.h>
+#include <list.h>
+#include <string.h>
+#include <debug.h>
+#include "filesys/directory.h"
+#include "filesys/cache.h"
+#include "threads/synch.h"
+
+#define DCACHE_SIZE 256          /* the number of cached names */
+
+/* structure for name cache entry, maps (parent dir sector, name)
+ * to the sector of the named inode */
+struct dcache_entry
+{
+  block_sector_t parent;           /* sector of the parent dir */
+  char name[NAME_MAX + 1];         /* component name */
+  block_sector_t sector;           /* sector of the named inode,
+  	  	  	  	  	  	  	  	  	  INVALID_SECTOR_ID if negative */
+  bool is_dir;                     /* whether the named inode is a dir */
+  struct hash_elem hash_elem;      /* hash elem for dcache_hash */
+  struct list_elem lru_elem;       /* list elem for dcache_lru or
+  	  	  	  	  	  	  	  	  	  dcache_free_list */
+};
+
+static struct dcache_entry dcache[DCACHE_SIZE];  /* all entries */
+static struct hash dcache_hash;      /* in-use entries by (parent, name) */
+static struct list dcache_lru;       /* in-use entries, most recent first */
+static struct list dcache_free_list; /* unused entries */
+static struct lock dcache_lock;      /* lock for the whole name cache */
+
+static unsigned dcache_hash_func(const struct hash_elem *e, void *aux);
+static bool dcache_less_func(const struct hash_elem *a,
+		const struct hash_elem *b, void *aux);
+static struct dcache_entry *dcache_find(block_sector_t parent,
+		const char *name);
+static void dcache_drop(struct dcache_entry *de);
+
+/* initialize the name cache */
+void dcache_init(void) {
+	int i;
+	lock_init(&dcache_lock);
+	list_init(&dcache_lru);
+	list_init(&dcache_free_list);
+	if (!hash_init(&dcache_hash, dcache_hash_func, dcache_less_func,
+			NULL)) {
+		PANIC ("fail to init name cache");
+	}
+	for (i = 0; i < DCACHE_SIZE; i++) {
+		list_push_back(&dcache_free_list, &dcache[i].lru_elem);
+	}
+}
+
+/* search the name cache for NAME in the dir at sector PARENT.
+ * returns false on a miss. on a hit returns true and sets *SECTOR
+ * to the named inode, or to INVALID_SECTOR_ID if NAME is known
+ * not to exist; *IS_DIR is set if IS_DIR is non-null */
+bool dcache_lookup(block_sector_t parent, const char *name,
+		block_sector_t *sector, bool *is_dir) {
+	ASSERT (name != NULL);
+	if (strlen(name) > NAME_MAX) {
+		return false;
+	}
+	lock_acquire(&dcache_lock);
+	struct dcache_entry *de = dcache_find(parent, name);
+	if (de == NULL) {
+		lock_release(&dcache_lock);
+		return false;
+	}
+	/*move to the front of the lru list*/
+	list_remove(&de->lru_elem);
+	list_push_front(&dcache_lru, &de->lru_elem);
+	*sector = de->sector;
+	if (is_dir != NULL) {
+		*is_dir = de->is_dir;
+	}
+	lock_release(&dcache_lock);
+	return true;
+}
+
+/* record that NAME in the dir at sector PARENT refers to SECTOR,
+ * pass INVALID_SECTOR_ID as SECTOR for a negative entry */
+void dcache_insert(block_sector_t parent, const char *name,
+		block_sector_t sector, bool is_dir) {
+	ASSERT (name != NULL);
+	if (strlen(name) > NAME_MAX) {
+		return;
+	}
+	lock_acquire(&dcache_lock);
+	struct dcache_entry *de = dcache_find(parent, name);
+	if (de != NULL) {
+		/*update the existing entry in place*/
+		list_remove(&de->lru_elem);
+	} else {
+		if (list_empty(&dcache_free_list)) {
+			/*evict the least recently used entry*/
+			dcache_drop(list_entry(list_back(&dcache_lru),
+					struct dcache_entry, lru_elem));
+		}
+		de = list_entry(list_pop_front(&dcache_free_list),
+				struct dcache_entry, lru_elem);
+		de->parent = parent;
+		strlcpy(de->name, name, sizeof de->name);
+		hash_insert(&dcache_hash, &de->hash_elem);
+	}
+	de->sector = sector;
+	de->is_dir = is_dir;
+	list_push_front(&dcache_lru, &de->lru_elem);
+	lock_release(&dcache_lock);
+}
+
+/* forget what is known about NAME in the dir at sector PARENT */
+void dcache_invalidate(block_sector_t parent, const char *name) {
+	ASSERT (name != NULL);
+	lock_acquire(&dcache_lock);
+	struct dcache_entry *de = dcache_find(parent, name);
+	if (de != NULL) {
+		dcache_drop(de);
+	}
+	lock_release(&dcache_lock);
+}
+
+/* forget every entry inside, or naming, the inode at SECTOR.
+ * used when the inode is removed, since its sector may be reused */
+void dcache_invalidate_sector(block_sector_t sector) {
+	struct list_elem *e;
+	struct list_elem *next;
+	struct dcache_entry *de;
+
+	lock_acquire(&dcache_lock);
+	for (e = list_begin(&dcache_lru); e != list_end(&dcache_lru);
+			e = next) {
+		next = list_next(e);
+		de = list_entry(e, struct dcache_entry, lru_elem);
+		if (de->parent == sector || de->sector == sector) {
+			dcache_drop(de);
+		}
+	}
+	lock_release(&dcache_lock);
+}
+
+/* find the entry for (PARENT, NAME), must hold dcache_lock */
+static struct dcache_entry *dcache_find(block_sector_t parent,
+		const char *name) {
+	ASSERT(lock_held_by_current_thread(&dcache_lock));
+	struct dcache_entry key;
+	key.parent = parent;
+	strlcpy(key.name, name, sizeof key.name);
+	struct hash_elem *e = hash_find(&dcache_hash, &key.hash_elem);
+	return e != NULL ? hash_entry(e, struct dcache_entry, hash_elem) : NULL;
+}
+
+/* move an in-use entry back to the free list, must hold dcache_lock */
+static void dcache_drop(struct dcache_entry *de) {
+	ASSERT(lock_held_by_current_thread(&dcache_lock));
+	hash_delete(&dcache_hash, &de->hash_elem);
+	list_remove(&de->lru_elem);
+	list_push_back(&dcache_free_list, &de->lru_elem);
+}
+
+/* hash function for dcache_hash */
+static unsigned dcache_hash_func(const struct hash_elem *e,
+		void *aux UNUSED) {
+	const struct dcache_entry *de = hash_entry(e, struct dcache_entry,
+			hash_elem);
+	return hash_string(de->name) ^ hash_int((int)de->parent);
+}
+
+/* less function for dcache_hash */
+static bool dcache_less_func(const struct hash_elem *a,
+		const struct hash_elem *b, void *aux UNUSED) {
+	const struct dcache_entry *da = hash_entry(a, struct dcache_entry,
+			hash_elem);
+	const struct dcache_entry *db = hash_entry(b, struct dcache_entry,
+			hash_elem);
+	if (da->parent != db->parent) {
+		return da->parent < db->parent;
+	}
+	return strcmp(da->name, db->name) < 0;
+}
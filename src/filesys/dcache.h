@@ -0,0 +1,15 @@
+#ifndef FILESYS_DCACHE_H
+#define FILESYS_DCACHE_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+
+void dcache_init(void);
+bool dcache_lookup(block_sector_t parent, const char *name,
+		block_sector_t *sector, bool *is_dir);
+void dcache_insert(block_sector_t parent, const char *name,
+		block_sector_t sector, bool is_dir);
+void dcache_invalidate(block_sector_t parent, const char *name);
+void dcache_invalidate_sector(block_sector_t sector);
+
+#endif /* filesys/dcache.h */
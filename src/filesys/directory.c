@@ -6,9 +6,11 @@
 #include "filesys/inode.h"
 #include "threads/malloc.h"
 #include "filesys/cache.h"
+#include "filesys/dcache.h"
 #include "threads/thread.h"
 
-
+/*number of dir entries fetched by one inode read in dir_readdir_batch*/
+#define DIR_READ_CHUNK 16
 
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
@@ -122,11 +124,25 @@ dir_lookup (const struct dir *dir, const char *name,
 	  lock_acquire(&dir->inode->dir_lock);
   }
 
-  if (lookup (dir, name, &e, NULL))
+  /* try the name cache first, under dir_lock so that the entry can
+     not be removed and its sector reused before it is opened */
+  block_sector_t sector;
+  bool cached = dcache_lookup (dir->inode->sector, name, &sector, NULL);
+  if (cached)
+    *inode = sector != INVALID_SECTOR_ID ? inode_open (sector) : NULL;
+  else if (lookup (dir, name, &e, NULL))
     *inode = inode_open (e.inode_sector);
   else
     *inode = NULL;
 
+  /* remember the result, a removed dir may have its sector reused */
+  if (!cached && !dir->inode->removed) {
+	  if (*inode != NULL)
+		  dcache_insert (dir->inode->sector, name, e.inode_sector, e.is_dir);
+	  else
+		  dcache_insert (dir->inode->sector, name, INVALID_SECTOR_ID, false);
+  }
+
   bool result = *inode != NULL;
 
   if (!holding_dir_lock) {
@@ -221,7 +237,13 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector,
 	  		  goto done;
 	  }
 	  inode_close(new_inode);
+
+	  /* drop stale names left from an earlier user of the sector */
+	  dcache_invalidate_sector (inode_sector);
+	  dcache_insert (inode_sector, "..", dir->inode->sector, true);
+	  dcache_insert (inode_sector, ".", inode_sector, true);
   }
+  dcache_insert (dir->inode->sector, name, inode_sector, is_dir);
 
  done:
   if (!holding_dir_lock) {
@@ -286,6 +308,8 @@ dir_remove (struct dir *dir, const char *name)
 
   /* Remove inode. */
   inode_remove (inode);
+  dcache_invalidate_sector (inode->sector);
+  dcache_insert (dir->inode->sector, name, INVALID_SECTOR_ID, false);
   success = true;
 
  done:
@@ -327,6 +351,46 @@ dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
   return false;
 }
 
+/* Reads up to MAX_ENTRIES directory entries (other than . or ..) from
+   DIR's current position into ENTRIES.  Records are fetched from the
+   inode a chunk at a time under a single dir_lock acquisition.
+   Returns the number of entries stored, 0 at the end of DIR. */
+int
+dir_readdir_batch (struct dir *dir, struct dir_entry *entries,
+		int max_entries)
+{
+  struct dir_entry chunk[DIR_READ_CHUNK];
+  int cnt = 0;
+  bool holding_dir_lock = lock_held_by_current_thread (
+		  &dir->inode->dir_lock);
+  if (!holding_dir_lock) {
+	  lock_acquire(&dir->inode->dir_lock);
+  }
+  while (cnt < max_entries)
+    {
+      /* inode_read_at() fails a read past the end, so clamp it */
+      int left = (inode_length (dir->inode) - dir->pos) / sizeof *chunk;
+      int want = left < DIR_READ_CHUNK ? left : DIR_READ_CHUNK;
+      if (want <= 0
+          || inode_read_at (dir->inode, chunk, want * sizeof *chunk,
+                            dir->pos) != (off_t) (want * sizeof *chunk))
+        break;
+
+      int i;
+      for (i = 0; i < want && cnt < max_entries; i++)
+        {
+          dir->pos += sizeof *chunk;
+          if (chunk[i].in_use && strcmp(chunk[i].name, ".") != 0
+              && strcmp(chunk[i].name, "..") != 0)
+            entries[cnt++] = chunk[i];
+        }
+    }
+  if (!holding_dir_lock) {
+	  lock_release(&dir->inode->dir_lock);
+  }
+  return cnt;
+}
+
 /*helper function*/
 
 /*traverse the given path to get a opened dir and file base name*/
@@ -396,22 +460,39 @@ struct dir* path_to_dir(char* path_, char* file_name_out){
 	}
 
 	/*set the starting point of dir traversing*/
-	struct dir *dir;
-	if(relative_path){
-		dir=dir_open(inode_open(thread_current()->cwd_sector));
+	struct dir *cwd = thread_current()->cwd;
+	block_sector_t sector;
+	if(relative_path && cwd != NULL){
+		/*fail if the cwd has been removed*/
+		if (cwd->inode->removed) {
+			return NULL;
+		}
+		sector=cwd->inode->sector;
 	}else{
-		dir= dir_open_root ();
-	}
-
-	/*if the starting dir is not dir or it's marked as removed fail it*/
-	if (!dir->inode->is_dir || dir->inode->removed) {
-		dir_close (dir);
-		return NULL;
+		sector=ROOT_DIR_SECTOR;
 	}
 
+	struct dir *dir;
 	struct inode *inode = NULL;
+	block_sector_t next_sector;
+	bool is_dir;
 	for(i=0;i<count;i++){
+		/*a cached name costs only a hash probe, removed dirs are never
+		 * cached, so a hit is known to be a live dir*/
+		if(dcache_lookup(sector, dirs[i], &next_sector, &is_dir)){
+			if(next_sector==INVALID_SECTOR_ID || !is_dir) return NULL;
+			sector=next_sector;
+			continue;
+		}
+
+		/*missed, scan the dir on disk, which fills the cache*/
+		dir=dir_open(inode_open(sector));
 		if (dir == NULL) return NULL;
+		/*if the dir is not dir or it's marked as removed fail it*/
+		if (!dir->inode->is_dir || dir->inode->removed) {
+			dir_close (dir);
+			return NULL;
+		}
 		if(!dir_lookup (dir, dirs[i], &inode)) {
 			dir_close (dir);
 			return NULL;
@@ -423,8 +504,21 @@ struct dir* path_to_dir(char* path_, char* file_name_out){
 			dir_close (dir);
 			return NULL;
 		}
+		sector=inode->sector;
+		inode_close(inode);
 		dir_close (dir);
-		dir = dir_open (inode);
+	}
+
+	/*open the dir the traversal ended in, a plain name relative to
+	 * the cwd just reuses the cwd's inode*/
+	if(relative_path && cwd != NULL && count == 0){
+		return dir_reopen(cwd);
+	}
+	dir=dir_open(inode_open(sector));
+	if (dir == NULL) return NULL;
+	if (!dir->inode->is_dir || dir->inode->removed) {
+		dir_close (dir);
+		return NULL;
 	}
 	return dir;
 }
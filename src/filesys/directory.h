@@ -45,6 +45,7 @@ bool dir_lookup (const struct dir *, const char *name, struct inode **);
 bool dir_add (struct dir *, const char *name, block_sector_t, bool is_dir);
 bool dir_remove (struct dir *, const char *name);
 bool dir_readdir (struct dir *, char name[NAME_MAX + 1]);
+int dir_readdir_batch (struct dir *, struct dir_entry *, int max_entries);
 
 void relative_path_to_absolute(char* relative_path,char* result_path);
 struct dir* path_to_dir(char* path_,char* file_name_out);
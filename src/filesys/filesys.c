@@ -7,6 +7,7 @@
 #include "filesys/inode.h"
 #include "filesys/directory.h"
 #include "filesys/cache.h"
+#include "filesys/dcache.h"
 #include "threads/thread.h"
 
 /*define the max num of entries a dir can have*/
@@ -35,6 +36,9 @@ filesys_init (bool format)
   	  PANIC ("fail to init buffer cache, can't initialize file system.");
     }
 
+    /*init path lookup name cache*/
+    dcache_init();
+
   if (format) 
     do_format ();
 
@@ -135,19 +139,7 @@ filesys_open (const char *name)
   struct dir *dir = NULL;
   char name_to_open[NAME_MAX + 1];
 
-  /*validate cwd if the name is a relative path*/
-  if(name[0]!='/'){
-	  struct dir *dummy_dir = path_to_dir(".",name_to_open);
-
-	  if(dummy_dir==NULL){
-		  /*fail, return */
-		  return NULL;
-	  }
-	  else{
-		  dir_close(dummy_dir);
-	  }
-  }
-
+  /*path_to_dir fails if the name is relative and the cwd is removed*/
   dir = path_to_dir((char *)name,name_to_open);
 
   if(dir==NULL){
@@ -156,6 +148,7 @@ filesys_open (const char *name)
 
   /*if open root, file open the root*/
   if(strlen(name_to_open)==0){
+	dir_close (dir);
 	inode = inode_open (ROOT_DIR_SECTOR);
 	return file_open (inode);
   }else{
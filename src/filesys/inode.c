@@ -84,6 +84,50 @@ byte_to_sector (const struct inode *inode, off_t pos)
     return INVALID_SECTOR_ID;
 }
 
+/* Returns the sector that contains byte offset POS within INODE in
+   *SECTOR, reading only the inode and index blocks that are already in
+   the buffer cache.  Returns false if one of them is not cached. */
+static bool
+cached_byte_to_sector (const struct inode *inode, off_t pos,
+		block_sector_t *sector)
+{
+	off_t sector_pos = pos/BLOCK_SECTOR_SIZE;
+	struct inode_disk id;
+	struct indirect_block ib;
+
+	if (!cache_contains(inode->sector))
+		return false;
+	cache_read(inode->sector, INVALID_SECTOR_ID, &id, 0, BLOCK_SECTOR_SIZE);
+
+	if (sector_pos < DIRECT_INDEX_NUM) {
+		*sector = id.direct_idx[sector_pos];
+		return true;
+	}
+
+	if (sector_pos < DIRECT_INDEX_NUM+INDEX_PER_SECTOR) {
+		if (!cache_contains(id.single_idx))
+			return false;
+		cache_read(id.single_idx, INVALID_SECTOR_ID, &ib, 0,
+				BLOCK_SECTOR_SIZE);
+		*sector = ib.sectors[sector_pos-DIRECT_INDEX_NUM];
+		return true;
+	}
+
+	off_t double_level_idx = (sector_pos-
+			(DIRECT_INDEX_NUM+INDEX_PER_SECTOR)) / INDEX_PER_SECTOR;
+	off_t single_level_idx = (sector_pos-
+			(DIRECT_INDEX_NUM+INDEX_PER_SECTOR)) % INDEX_PER_SECTOR;
+	if (!cache_contains(id.double_idx))
+		return false;
+	cache_read(id.double_idx, INVALID_SECTOR_ID, &ib, 0, BLOCK_SECTOR_SIZE);
+	block_sector_t single_sector = ib.sectors[double_level_idx];
+	if (!cache_contains(single_sector))
+		return false;
+	cache_read(single_sector, INVALID_SECTOR_ID, &ib, 0, BLOCK_SECTOR_SIZE);
+	*sector = ib.sectors[single_level_idx];
+	return true;
+}
+
 /* List of open inodes, so that opening a single inode twice
    returns the same `struct inode'. */
 static struct list open_inodes;
@@ -724,12 +768,19 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size_,
     return 0;
 
   struct inode_disk id;
-  lock_acquire(&inode->inode_lock);
+  /* the caller may hold the lock across several writes */
+  bool holding_inode_lock = lock_held_by_current_thread
+		  (&inode->inode_lock);
+  if (!holding_inode_lock) {
+	  lock_acquire(&inode->inode_lock);
+  }
   cache_read(inode->sector, INVALID_SECTOR_ID, &id, 0, BLOCK_SECTOR_SIZE);
   int phy_length = (int)id.length;
   if (offset + size > phy_length) {
 	  if(!zero_padding(inode, &id, phy_length, offset+size)){
-		  lock_release(&inode->inode_lock);
+		  if (!holding_inode_lock) {
+			  lock_release(&inode->inode_lock);
+		  }
 		  return 0;
 	  }
   }
@@ -761,10 +812,90 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size_,
     }
 
   inode->readable_length=id.length;
-  lock_release(&inode->inode_lock);
+  if (!holding_inode_lock) {
+	  lock_release(&inode->inode_lock);
+  }
   return bytes_written;
 }
 
+/* Copies SIZE bytes from SRC starting at SRC_OFFSET into DST starting
+   at DST_OFFSET, entirely inside the kernel.  Sectors needed to grow
+   DST are allocated in one batch up front, then data moves through
+   the buffer cache one sector-bounded chunk at a time.  SRC and DST
+   must be different inodes.  Returns the number of bytes copied,
+   which may be less than SIZE if end of SRC is reached. */
+off_t
+inode_copy_at (struct inode *dst, off_t dst_offset, struct inode *src,
+		off_t src_offset, off_t size)
+{
+  uint8_t chunk_buf[BLOCK_SECTOR_SIZE];
+  off_t bytes_copied = 0;
+
+  ASSERT (dst != src);
+
+  if (dst->deny_write_cnt)
+    return 0;
+
+  /* never copy past the end of SRC */
+  if (src_offset >= inode_length (src))
+    return 0;
+  if (size > inode_length (src) - src_offset)
+    size = inode_length (src) - src_offset;
+
+  struct inode_disk id;
+  bool holding_inode_lock = lock_held_by_current_thread
+		  (&dst->inode_lock);
+  if (!holding_inode_lock) {
+	  lock_acquire(&dst->inode_lock);
+  }
+  cache_read(dst->sector, INVALID_SECTOR_ID, &id, 0, BLOCK_SECTOR_SIZE);
+  if (dst_offset + size > id.length) {
+	  /* allocate every new sector of DST in one go */
+	  if(!zero_padding(dst, &id, id.length, dst_offset + size)){
+		  if (!holding_inode_lock) {
+			  lock_release(&dst->inode_lock);
+		  }
+		  return 0;
+	  }
+  }
+
+  while (size > 0)
+    {
+      block_sector_t src_sector = byte_to_sector (src, src_offset);
+      block_sector_t dst_sector = byte_to_sector_no_check (dst, dst_offset);
+      int src_sector_ofs = src_offset % BLOCK_SECTOR_SIZE;
+      int dst_sector_ofs = dst_offset % BLOCK_SECTOR_SIZE;
+
+      /* bounded by the end of both the SRC and the DST sector */
+      int src_left = BLOCK_SECTOR_SIZE - src_sector_ofs;
+      int dst_left = BLOCK_SECTOR_SIZE - dst_sector_ofs;
+      int chunk_size = src_left < dst_left ? src_left : dst_left;
+      if (size < chunk_size)
+        chunk_size = size;
+      if (src_sector == INVALID_SECTOR_ID)
+        break;
+
+      cache_read(src_sector, INVALID_SECTOR_ID, chunk_buf, src_sector_ofs,
+    		  chunk_size);
+      cache_write(dst_sector, chunk_buf, dst_sector_ofs, chunk_size);
+
+      /* Advance. */
+      size -= chunk_size;
+      src_offset += chunk_size;
+      dst_offset += chunk_size;
+      bytes_copied += chunk_size;
+    }
+
+  /* publish the new length only once the data is there, up to where
+     the copy got */
+  if (dst_offset > dst->readable_length)
+    dst->readable_length = dst_offset;
+  if (!holding_inode_lock) {
+	  lock_release(&dst->inode_lock);
+  }
+  return bytes_copied;
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
@@ -796,6 +927,27 @@ inode_length (const struct inode *inode)
   return inode->readable_length;
 }
 
+/* Returns true if the SIZE bytes of INODE starting at OFFSET can
+   be read without disk I/O, i.e. their data sectors and the index
+   blocks leading to them are all in the buffer cache. */
+bool
+inode_cached (const struct inode *inode, off_t offset, off_t size)
+{
+  off_t pos;
+
+  if (offset + size > inode->readable_length)
+    return false;
+  for (pos = offset - offset % BLOCK_SECTOR_SIZE; pos < offset + size;
+       pos += BLOCK_SECTOR_SIZE)
+    {
+      block_sector_t sector;
+      if (!cached_byte_to_sector (inode, pos, &sector)
+          || sector == INVALID_SECTOR_ID || !cache_contains (sector))
+        return false;
+    }
+  return true;
+}
+
 /* flush all caches into disk */
 void inode_flush_cache(void) {
 	force_flush_all_cache();
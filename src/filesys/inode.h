@@ -60,9 +60,12 @@ void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size,
 		 off_t offset);
+off_t inode_copy_at (struct inode *dst, off_t dst_offset,
+		struct inode *src, off_t src_offset, off_t size);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
+bool inode_cached (const struct inode *, off_t offset, off_t size);
 void inode_flush_cache(void);
 void force_close_all_open_inodes(void);
 bool append_sector_to_inode(struct inode_disk *id,
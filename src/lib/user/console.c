@@ -3,6 +3,16 @@
 #include <syscall.h>
 #include <syscall-nr.h>
 
+/* Standard output buffer.  Everything console.c writes to
+   STDOUT_FILENO goes through it, and write() to STDOUT_FILENO
+   flushes it first, so output stays in order. */
+static char stdout_buf[STDOUT_BUFSIZ];
+static size_t stdout_len;
+static int stdout_mode = _IOLBF;
+
+static void stdout_putc (char);
+static void stdout_write (const char *, size_t);
+
 /* The standard vprintf() function,
    which is like printf() but uses a va_list. */
 int
@@ -30,8 +40,8 @@ hprintf (int handle, const char *format, ...)
 int
 puts (const char *s) 
 {
-  write (STDOUT_FILENO, s, strlen (s));
-  putchar ('\n');
+  stdout_write (s, strlen (s));
+  stdout_putc ('\n');
 
   return 0;
 }
@@ -40,10 +50,70 @@ puts (const char *s)
 int
 putchar (int c) 
 {
-  char c2 = c;
-  write (STDOUT_FILENO, &c2, 1);
+  stdout_putc (c);
   return c;
 }
+
+/* Sets the buffering of HANDLE to MODE, one of _IOFBF, _IOLBF
+   or _IONBF, flushing anything already buffered.  Only
+   STDOUT_FILENO is buffered.  Returns 0 if successful, -1
+   otherwise. */
+int
+hsetvbuf (int handle, int mode)
+{
+  if (handle != STDOUT_FILENO
+      || (mode != _IOFBF && mode != _IOLBF && mode != _IONBF))
+    return -1;
+  hflush (handle);
+  stdout_mode = mode;
+  return 0;
+}
+
+/* Writes out anything buffered for HANDLE.  Returns 0. */
+int
+hflush (int handle)
+{
+  if (handle == STDOUT_FILENO && stdout_len > 0)
+    {
+      /* Empty the buffer before writing, since write() to
+         STDOUT_FILENO calls back in here. */
+      size_t len = stdout_len;
+      stdout_len = 0;
+      write (STDOUT_FILENO, stdout_buf, len);
+    }
+  return 0;
+}
+
+/* Writes C to standard output according to its buffering mode. */
+static void
+stdout_putc (char c)
+{
+  if (stdout_mode == _IONBF)
+    {
+      write (STDOUT_FILENO, &c, 1);
+      return;
+    }
+  stdout_buf[stdout_len++] = c;
+  if (stdout_len == sizeof stdout_buf
+      || (c == '\n' && stdout_mode == _IOLBF))
+    hflush (STDOUT_FILENO);
+}
+
+/* Writes the SIZE bytes in BUF to standard output according to
+   its buffering mode.  What does not fit in the buffer is
+   written directly. */
+static void
+stdout_write (const char *buf, size_t size)
+{
+  if (stdout_mode == _IONBF || size >= sizeof stdout_buf)
+    {
+      hflush (STDOUT_FILENO);
+      write (STDOUT_FILENO, buf, size);
+      return;
+    }
+  while (size-- > 0)
+    stdout_putc (*buf++);
+}
 
 /* Auxiliary data for vhprintf_helper(). */
 struct vhprintf_aux 
@@ -55,6 +125,7 @@ struct vhprintf_aux
   };
 
 static void add_char (char, void *);
+static void add_stdout_char (char, void *);
 static void flush (struct vhprintf_aux *);
 
 /* Formats the printf() format specification FORMAT with
@@ -64,6 +135,14 @@ int
 vhprintf (int handle, const char *format, va_list args) 
 {
   struct vhprintf_aux aux;
+  if (handle == STDOUT_FILENO && stdout_mode != _IONBF)
+    {
+      /* Format straight into the stdout buffer. */
+      aux.char_cnt = 0;
+      __vprintf (format, args, add_stdout_char, &aux.char_cnt);
+      return aux.char_cnt;
+    }
+
   aux.p = aux.buf;
   aux.char_cnt = 0;
   aux.handle = handle;
@@ -84,6 +163,15 @@ add_char (char c, void *aux_)
   aux->char_cnt++;
 }
 
+/* Adds C to the stdout buffer and counts it in the int that
+   CNT points to. */
+static void
+add_stdout_char (char c, void *cnt)
+{
+  stdout_putc (c);
+  ++*(int *) cnt;
+}
+
 /* Flushes the buffer in AUX. */
 static void
 flush (struct vhprintf_aux *aux)
@@ -1,10 +1,24 @@
 #include <syscall.h>
+#include <stdint.h>
 
 int main (int, char *[]);
 void _start (int argc, char *argv[]);
 
+static bool cpu_has_sysenter (void);
+
 void
 _start (int argc, char *argv[]) 
 {
+  syscall_use_sysenter = cpu_has_sysenter ();
   exit (main (argc, argv));
 }
+
+/* Returns true if CPUID reports sysenter and sysexit.  The kernel
+   makes the same check before setting them up. */
+static bool
+cpu_has_sysenter (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+  asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+  return (edx & (1 << 11)) != 0;
+}
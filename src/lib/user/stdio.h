@@ -4,4 +4,15 @@
 int hprintf (int, const char *, ...) PRINTF_FORMAT (2, 3);
 int vhprintf (int, const char *, va_list) PRINTF_FORMAT (2, 0);
 
+/* Buffering modes for hsetvbuf(). */
+#define _IOFBF 0        /* Write when the buffer fills. */
+#define _IOLBF 1        /* Write at each new-line, the default. */
+#define _IONBF 2        /* Write right away. */
+
+/* Size of the standard output buffer. */
+#define STDOUT_BUFSIZ 512
+
+int hsetvbuf (int, int mode);
+int hflush (int);
+
 #endif /* lib/user/stdio.h */
@@ -15,6 +15,81 @@ typedef int mapid_t;
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
+/* A directory entry written by getdents(). */
+struct dirent
+  {
+    int inumber;                        /* Inode number. */
+    bool is_dir;                        /* Is it a directory? */
+    char name[READDIR_MAX_LEN + 1];     /* Null terminated file name. */
+  };
+
+/* A buffer for readv() and writev(). */
+struct iovec
+  {
+    void *iov_base;                     /* Start of the buffer. */
+    unsigned iov_len;                   /* Size of the buffer in bytes. */
+  };
+
+/* Maximum number of buffers passed to readv() or writev(). */
+#define IOV_MAX 64
+
+/* Async I/O operations, the opcode of struct io_sqe. */
+#define IO_OP_READ 0            /* Read LEN bytes at OFFSET into BUF. */
+#define IO_OP_WRITE 1           /* Write LEN bytes from BUF at OFFSET. */
+#define IO_OP_FSYNC 2           /* Flush written data to disk. */
+#define IO_OP_OPEN 3            /* Open the file named by BUF. */
+
+/* An async I/O submission queue entry. */
+struct io_sqe
+  {
+    int opcode;                         /* One of IO_OP_*. */
+    int fd;                             /* File to operate on. */
+    void *buf;                          /* Data buffer, or path for open. */
+    unsigned len;                       /* Size of BUF in bytes. */
+    unsigned offset;                    /* File position, not updated. */
+    unsigned user_data;                 /* Copied to the completion. */
+  };
+
+/* An async I/O completion queue entry. */
+struct io_cqe
+  {
+    unsigned user_data;                 /* From the submission. */
+    int result;                         /* Bytes, new fd, 0 or -1. */
+  };
+
+/* Number of entries in each queue of an async I/O ring. */
+#define IO_RING_ENTRIES 64
+
+/* An async I/O ring shared by a process and the kernel.  The
+   process fills sqes[sq_tail % entries] and advances sq_tail, the
+   kernel advances sq_head as it takes them.  The kernel fills
+   cqes[cq_tail % entries] and advances cq_tail, the process
+   advances cq_head as it consumes them. */
+struct io_ring
+  {
+    unsigned sq_head, sq_tail;          /* Submission queue indexes. */
+    unsigned cq_head, cq_tail;          /* Completion queue indexes. */
+    unsigned entries;                   /* Always IO_RING_ENTRIES. */
+    struct io_sqe sqes[IO_RING_ENTRIES];
+    struct io_cqe cqes[IO_RING_ENTRIES];
+  };
+
+/* One system call run by batch().  The layout matches the
+   arguments int $0x30 finds on the user stack, so NUMBER and ARGS
+   are read in place.  With STOP_ON_ERROR, batch() stops after the
+   first record that fails: false from create, remove, chdir, mkdir
+   or readdir, a negative result from the others.  Seek and close
+   report 0 and, like wait, never stop the batch. */
+struct syscall_rec
+  {
+    int number;                         /* SYS_* system call number. */
+    unsigned args[4];                   /* Arguments, unused ones ignored. */
+    int result;                         /* Return value, set by the kernel. */
+  };
+
+/* Maximum number of records passed to batch(). */
+#define BATCH_MAX 64
+
 /* Typical return values from main() and arguments to exit(). */
 #define EXIT_SUCCESS 0          /* Successful execution. */
 #define EXIT_FAILURE 1          /* Unsuccessful execution. */
@@ -45,4 +120,20 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+int getdents (int fd, struct dirent *entries, unsigned max_entries);
+int pread (int fd, void *buffer, unsigned length, unsigned position);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned position);
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+int copy_file_range (int fd_in, int fd_out, unsigned length);
+int io_setup (struct io_ring *ring);
+int io_enter (unsigned to_submit, unsigned min_complete);
+int batch (struct syscall_rec *recs, unsigned count, bool stop_on_error);
+pid_t fork (void);
+
+/* True if system calls enter the kernel through sysenter, false
+   if through int $0x30. */
+extern bool syscall_use_sysenter;
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,34 @@
+/* Submits reads and writes through an async I/O ring and exits
+   without reaping them.  The kernel must finish or drop the
+   requests on its own. */
+
+#include <syscall.h>
+#include "tests/userprog/io-ring.h"
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define REQ_CNT 16
+
+static char bufs[REQ_CNT][sizeof sample];
+
+void
+test_main (void) 
+{
+  int in, out;
+  int i;
+
+  CHECK ((in = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (create ("out", 0), "create \"out\"");
+  CHECK ((out = open ("out")) > 1, "open \"out\"");
+  ring_init ();
+
+  for (i = 0; i < REQ_CNT; i++)
+    {
+      ring_queue (IO_OP_READ, in, bufs[i], sizeof sample, 0, i);
+      ring_queue (IO_OP_WRITE, out, sample, sizeof sample,
+                  i * sizeof sample, REQ_CNT + i);
+    }
+  CHECK (io_enter (2 * REQ_CNT, 0) == 2 * REQ_CNT,
+         "submit %d requests", 2 * REQ_CNT);
+}
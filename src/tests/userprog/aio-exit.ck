@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(aio-exit) begin
+(aio-exit) open "sample.txt"
+(aio-exit) create "out"
+(aio-exit) open "out"
+(aio-exit) io_setup
+(aio-exit) submit 32 requests
+(aio-exit) end
+aio-exit: exit(0)
+EOF
+pass;
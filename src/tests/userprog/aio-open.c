@@ -0,0 +1,49 @@
+/* Opens files through an async I/O ring, then reads the one that
+   exists through the ring as well. */
+
+#include <syscall.h>
+#include "tests/userprog/io-ring.h"
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char present[] = "sample.txt";
+static char missing[] = "no-such-file";
+
+void
+test_main (void) 
+{
+  char buf[sizeof sample - 1];
+  int results[2];
+  struct io_cqe cqe;
+  int fd;
+  int i;
+
+  ring_init ();
+  ring_queue (IO_OP_OPEN, 0, present, 0, 0, 0);
+  ring_queue (IO_OP_OPEN, 0, missing, 0, 0, 1);
+  CHECK (io_enter (2, 2) == 2, "submit two opens");
+
+  /* The opens may complete in either order. */
+  results[0] = results[1] = 0;
+  for (i = 0; i < 2; i++) 
+    {
+      cqe = ring_reap ();
+      if (cqe.user_data > 1)
+        fail ("bad user_data %u", cqe.user_data);
+      results[cqe.user_data] = cqe.result;
+    }
+  CHECK (results[0] > 1, "open \"%s\"", present);
+  CHECK (results[1] == -1, "open \"%s\"", missing);
+  fd = results[0];
+
+  ring_queue (IO_OP_READ, fd, buf, sizeof buf, 0, 2);
+  CHECK (io_enter (1, 1) == 1, "submit read");
+  cqe = ring_reap ();
+  CHECK (cqe.user_data == 2 && cqe.result == (int) sizeof buf,
+         "reap read");
+  compare_bytes (buf, sample, sizeof buf, 0, present);
+
+  /* The fd works with the ordinary calls too. */
+  check_file_handle (fd, present, sample, sizeof sample - 1);
+}
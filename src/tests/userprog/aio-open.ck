@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(aio-open) begin
+(aio-open) io_setup
+(aio-open) submit two opens
+(aio-open) open "sample.txt"
+(aio-open) open "no-such-file"
+(aio-open) submit read
+(aio-open) reap read
+(aio-open) verified contents of "sample.txt"
+(aio-open) end
+aio-open: exit(0)
+EOF
+pass;
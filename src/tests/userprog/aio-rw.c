@@ -0,0 +1,36 @@
+/* Writes sample data to a file through an async I/O ring, then
+   reads it back through the ring and verifies it. */
+
+#include <syscall.h>
+#include "tests/userprog/io-ring.h"
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[sizeof sample];
+  struct io_cqe cqe;
+  int fd;
+
+  CHECK (create ("data", sizeof sample), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  ring_init ();
+
+  ring_queue (IO_OP_WRITE, fd, sample, sizeof sample, 0, 1);
+  CHECK (io_enter (1, 1) == 1, "submit write");
+  cqe = ring_reap ();
+  CHECK (cqe.user_data == 1 && cqe.result == (int) sizeof sample,
+         "reap write");
+
+  ring_queue (IO_OP_READ, fd, buf, sizeof buf, 0, 2);
+  CHECK (io_enter (1, 1) == 1, "submit read");
+  cqe = ring_reap ();
+  CHECK (cqe.user_data == 2 && cqe.result == (int) sizeof buf,
+         "reap read");
+  compare_bytes (buf, sample, sizeof sample, 0, "data");
+
+  /* The ring does not move the file position. */
+  check_file_handle (fd, "data", sample, sizeof sample);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(aio-rw) begin
+(aio-rw) create "data"
+(aio-rw) open "data"
+(aio-rw) io_setup
+(aio-rw) submit write
+(aio-rw) reap write
+(aio-rw) submit read
+(aio-rw) reap read
+(aio-rw) verified contents of "data"
+(aio-rw) end
+aio-rw: exit(0)
+EOF
+pass;
@@ -0,0 +1,73 @@
+/* Runs create, remove, open, seek, read, close and wait through
+   batch(), and checks that with stop_on_error a create or remove
+   returning false stops the batch, while seek, close and a wait for
+   a child that exited with -1 do not.  Without stop_on_error the
+   remaining records still run. */
+
+#include <syscall.h>
+#include <syscall-nr.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define NOT_RUN 99
+
+static char name[] = "batch-file";
+static char missing[] = "no-such-file";
+static char buf[16];
+
+static void
+set_rec (struct syscall_rec *rec, int number,
+         unsigned arg0, unsigned arg1, unsigned arg2) 
+{
+  rec->number = number;
+  rec->args[0] = arg0;
+  rec->args[1] = arg1;
+  rec->args[2] = arg2;
+  rec->result = NOT_RUN;
+}
+
+void
+test_main (void) 
+{
+  struct syscall_rec recs[3];
+  pid_t child;
+  int fd;
+
+  set_rec (&recs[0], SYS_CREATE, (unsigned) name, 0, 0);
+  set_rec (&recs[1], SYS_CREATE, (unsigned) name, 0, 0);
+  set_rec (&recs[2], SYS_OPEN, (unsigned) name, 0, 0);
+  CHECK (batch (recs, 3, true) == 2, "batch create, create, open");
+  CHECK (recs[0].result == 1, "first create succeeded");
+  CHECK (recs[1].result == 0, "second create failed");
+  CHECK (recs[2].result == NOT_RUN, "open did not run");
+
+  set_rec (&recs[0], SYS_REMOVE, (unsigned) missing, 0, 0);
+  set_rec (&recs[1], SYS_OPEN, (unsigned) name, 0, 0);
+  CHECK (batch (recs, 2, true) == 1, "batch remove, open");
+  CHECK (recs[0].result == 0, "remove failed");
+  CHECK (recs[1].result == NOT_RUN, "open did not run");
+
+  set_rec (&recs[0], SYS_CREATE, (unsigned) name, 0, 0);
+  set_rec (&recs[1], SYS_OPEN, (unsigned) name, 0, 0);
+  CHECK (batch (recs, 2, false) == 2,
+         "batch create, open without stop_on_error");
+  CHECK (recs[0].result == 0, "create failed");
+  CHECK (recs[1].result > 1, "open ran");
+
+  CHECK ((fd = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  set_rec (&recs[0], SYS_SEEK, fd, 5, 0);
+  set_rec (&recs[1], SYS_READ, fd, (unsigned) buf, sizeof buf);
+  set_rec (&recs[2], SYS_CLOSE, fd, 0, 0);
+  CHECK (batch (recs, 3, true) == 3, "batch seek, read, close");
+  CHECK (recs[0].result == 0, "seek reported 0");
+  CHECK (recs[1].result == (int) sizeof buf, "read ran");
+  CHECK (recs[2].result == 0, "close reported 0");
+
+  /* The child's output comes before the wait returns. */
+  child = exec ("child-bad");
+  set_rec (&recs[0], SYS_WAIT, child, 0, 0);
+  set_rec (&recs[1], SYS_REMOVE, (unsigned) name, 0, 0);
+  CHECK (batch (recs, 2, true) == 2, "batch wait, remove");
+  CHECK (recs[0].result == -1, "wait returned -1");
+  CHECK (recs[1].result == 1, "remove ran");
+}
@@ -0,0 +1,30 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(batch-stop) begin
+(batch-stop) batch create, create, open
+(batch-stop) first create succeeded
+(batch-stop) second create failed
+(batch-stop) open did not run
+(batch-stop) batch remove, open
+(batch-stop) remove failed
+(batch-stop) open did not run
+(batch-stop) batch create, open without stop_on_error
+(batch-stop) create failed
+(batch-stop) open ran
+(batch-stop) open "sample.txt"
+(batch-stop) batch seek, read, close
+(batch-stop) seek reported 0
+(batch-stop) read ran
+(batch-stop) close reported 0
+(child-bad) begin
+child-bad: exit(-1)
+(batch-stop) batch wait, remove
+(batch-stop) wait returned -1
+(batch-stop) remove ran
+(batch-stop) end
+batch-stop: exit(0)
+EOF
+pass;
@@ -0,0 +1,41 @@
+/* Helpers for tests that drive an async I/O ring. */
+
+#include "tests/userprog/io-ring.h"
+#include "tests/lib.h"
+
+static struct io_ring ring;
+
+/* Registers the ring with the kernel. */
+void
+ring_init (void) 
+{
+  CHECK (io_setup (&ring) == 0, "io_setup");
+}
+
+/* Adds a submission to the ring, without entering the kernel. */
+void
+ring_queue (int opcode, int fd, void *buf, unsigned len,
+            unsigned offset, unsigned user_data) 
+{
+  struct io_sqe *sqe = &ring.sqes[ring.sq_tail % ring.entries];
+
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->buf = buf;
+  sqe->len = len;
+  sqe->offset = offset;
+  sqe->user_data = user_data;
+  ring.sq_tail++;
+}
+
+/* Returns the next completion, waiting for one if none is
+   posted yet.  Fails if nothing is in flight. */
+struct io_cqe
+ring_reap (void) 
+{
+  if (ring.cq_head == ring.cq_tail)
+    io_enter (0, 1);
+  if (ring.cq_head == ring.cq_tail)
+    fail ("no completion to reap");
+  return ring.cqes[ring.cq_head++ % ring.entries];
+}
@@ -0,0 +1,11 @@
+#ifndef TESTS_USERPROG_IO_RING_H
+#define TESTS_USERPROG_IO_RING_H
+
+#include <syscall.h>
+
+void ring_init (void);
+void ring_queue (int opcode, int fd, void *buf, unsigned len,
+                 unsigned offset, unsigned user_data);
+struct io_cqe ring_reap (void);
+
+#endif /* tests/userprog/io-ring.h */
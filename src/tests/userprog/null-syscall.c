@@ -0,0 +1,70 @@
+/* Measures the cost of a system call that does nothing, entering
+   the kernel through int $0x30 and, if the CPU has it, through
+   sysenter, and reports CPU cycles per call for each.
+
+   Not graded, since the numbers vary from run to run.  Run it
+   with "make tests/userprog/null-syscall.result" from the build
+   directory. */
+
+#include <stdint.h>
+#include <syscall-nr.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Number of calls timed for each path. */
+#define CALLS 10000
+
+/* A system call number the kernel does not know, so it only
+   enters and leaves. */
+#define SYS_NULL (-1)
+
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+static void
+null_int30 (void)
+{
+  asm volatile ("pushl %[number]; int $0x30; addl $4, %%esp"
+                : : [number] "i" (SYS_NULL) : "eax", "memory");
+}
+
+static void
+null_sysenter (void)
+{
+  asm volatile ("pushl %[number]; movl %%esp, %%ecx; movl $1f, %%edx; "
+                "sysenter; 1: addl $4, %%esp"
+                : : [number] "i" (SYS_NULL)
+                : "eax", "ecx", "edx", "memory");
+}
+
+/* Returns the average cycles per call of CALL. */
+static unsigned
+time_calls (void (*call) (void))
+{
+  uint64_t start;
+  int i;
+
+  /* Warm up the caches and TLB first. */
+  for (i = 0; i < CALLS / 10; i++)
+    call ();
+
+  start = rdtsc ();
+  for (i = 0; i < CALLS; i++)
+    call ();
+  return (rdtsc () - start) / CALLS;
+}
+
+void
+test_main (void)
+{
+  msg ("int 0x30: %u cycles/call", time_calls (null_int30));
+  if (syscall_use_sysenter)
+    msg ("sysenter: %u cycles/call", time_calls (null_sysenter));
+  else
+    msg ("sysenter: not supported");
+}
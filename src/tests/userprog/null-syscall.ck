@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+fail "missing int 0x30 timing\n"
+  if !grep (/^\(null-syscall\) int 0x30: \d+ cycles\/call$/, @output);
+fail "missing sysenter timing\n"
+  if !grep (/^\(null-syscall\) sysenter: (\d+ cycles\/call|not supported)$/,
+	    @output);
+pass;
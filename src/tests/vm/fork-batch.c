@@ -0,0 +1,23 @@
+/* Runs fork through batch(), which refuses it, since the child
+   would return into the record array instead of the user stack. */
+
+#include <syscall.h>
+#include <syscall-nr.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define NOT_RUN 99
+
+void
+test_main (void) 
+{
+  struct syscall_rec recs[2];
+
+  recs[0].number = SYS_FORK;
+  recs[0].result = NOT_RUN;
+  recs[1].number = SYS_FORK;
+  recs[1].result = NOT_RUN;
+  CHECK (batch (recs, 2, true) == 1, "batch fork, fork");
+  CHECK (recs[0].result == -1, "fork in batch returned -1");
+  CHECK (recs[1].result == NOT_RUN, "second fork did not run");
+}
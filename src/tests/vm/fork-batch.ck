@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork-batch) begin
+(fork-batch) batch fork, fork
+(fork-batch) fork in batch returned -1
+(fork-batch) second fork did not run
+(fork-batch) end
+fork-batch: exit(0)
+EOF
+pass;
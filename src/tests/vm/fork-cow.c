@@ -0,0 +1,48 @@
+/* Forks, then writes to a data, a bss and a stack page on both
+   sides at once, and checks that neither side sees the other's
+   writes. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int data = 1;
+static char bss[3 * 4096];
+
+void
+test_main (void) 
+{
+  char stack[4096];
+  pid_t pid;
+  int status;
+
+  memset (bss, 'b', sizeof bss);
+  memset (stack, 's', sizeof stack);
+
+  pid = fork ();
+  if (pid == 0) 
+    {
+      /* The parent's writes must not show up here. */
+      if (data != 1 || bss[0] != 'b' || bss[sizeof bss - 1] != 'b'
+          || stack[0] != 's' || stack[sizeof stack - 1] != 's')
+        exit (1);
+      data = 2;
+      memset (bss, 'c', sizeof bss);
+      memset (stack, 't', sizeof stack);
+      if (data != 2 || bss[0] != 'c' || bss[sizeof bss - 1] != 'c'
+          || stack[0] != 't' || stack[sizeof stack - 1] != 't')
+        exit (2);
+      exit (0);
+    }
+
+  data = 3;
+  memset (bss, 'p', sizeof bss);
+  memset (stack, 'q', sizeof stack);
+  status = wait (pid);
+  CHECK (pid > 0, "fork");
+  CHECK (status == 0, "child saw only its own writes");
+  CHECK (data == 3 && bss[0] == 'p' && bss[sizeof bss - 1] == 'p'
+         && stack[0] == 'q' && stack[sizeof stack - 1] == 'q',
+         "parent saw only its own writes");
+}
@@ -0,0 +1,42 @@
+/* Forks with a file open after reading part of it.  The child
+   reads on from the same offset, and its reads do not move the
+   parent's offset. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHUNK 10
+
+void
+test_main (void) 
+{
+  char buf[CHUNK];
+  pid_t pid;
+  int status;
+  int fd;
+
+  CHECK ((fd = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (read (fd, buf, CHUNK) == CHUNK, "read %d bytes", CHUNK);
+
+  pid = fork ();
+  if (pid == 0) 
+    {
+      if (tell (fd) != CHUNK)
+        exit (1);
+      if (read (fd, buf, CHUNK) != CHUNK
+          || memcmp (buf, sample + CHUNK, CHUNK))
+        exit (2);
+      exit (0);
+    }
+
+  status = wait (pid);
+  CHECK (pid > 0, "fork");
+  CHECK (status == 0, "child read on from offset %d", CHUNK);
+  CHECK (tell (fd) == CHUNK, "parent still at offset %d", CHUNK);
+  CHECK (read (fd, buf, CHUNK) == CHUNK
+         && !memcmp (buf, sample + CHUNK, CHUNK),
+         "parent read on from offset %d", CHUNK);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork-fd) begin
+(fork-fd) open "sample.txt"
+(fork-fd) read 10 bytes
+fork-fd: exit(0)
+(fork-fd) fork
+(fork-fd) child read on from offset 10
+(fork-fd) parent still at offset 10
+(fork-fd) parent read on from offset 10
+(fork-fd) end
+fork-fd: exit(0)
+EOF
+pass;
@@ -0,0 +1,57 @@
+/* Fills 2 MB of memory, so that much of it is swapped out, then
+   forks.  The child checks every byte and overwrites part of it,
+   and the parent checks that its own copy is intact. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 1024 * 1024)
+
+static char buf[SIZE];
+
+/* Returns the index of the first byte of BUF that does not hold
+   its pattern, or SIZE if all do. */
+static size_t
+check_pattern (void) 
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != (char) (i % 251))
+      break;
+  return i;
+}
+
+void
+test_main (void) 
+{
+  size_t i;
+  pid_t pid;
+  int status;
+
+  msg ("initialize");
+  for (i = 0; i < SIZE; i++)
+    buf[i] = i % 251;
+
+  pid = fork ();
+  if (pid == 0) 
+    {
+      if (check_pattern () != SIZE)
+        exit (1);
+      for (i = 0; i < SIZE; i += 4096 * 4)
+        buf[i] = ~buf[i];
+      for (i = 0; i < SIZE; i += 4096 * 4)
+        if (buf[i] != (char) ~(i % 251))
+          exit (2);
+      exit (0);
+    }
+
+  status = wait (pid);
+  CHECK (pid > 0, "fork");
+  CHECK (status == 0, "child saw the parent's pages");
+  i = check_pattern ();
+  if (i != SIZE)
+    fail ("byte %zu of the parent's copy changed", i);
+  msg ("parent's pages intact");
+}
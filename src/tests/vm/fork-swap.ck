@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork-swap) begin
+(fork-swap) initialize
+fork-swap: exit(0)
+(fork-swap) fork
+(fork-swap) child saw the parent's pages
+(fork-swap) parent's pages intact
+(fork-swap) end
+fork-swap: exit(0)
+EOF
+pass;
@@ -0,0 +1,25 @@
+/* Forks a child, which sees fork() return 0 and exits with a
+   status that the parent, which got the child's pid, reaps with
+   wait(). */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  pid_t pid;
+  int status;
+
+  pid = fork ();
+  if (pid == 0)
+    exit (81);
+
+  /* Print nothing until the child is done, so its exit message
+     comes first. */
+  status = wait (pid);
+  CHECK (pid > 0, "fork returned a pid");
+  CHECK (status == 81, "wait returned %d", status);
+  CHECK (wait (pid) == -1, "second wait returned -1");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork-wait) begin
+fork-wait: exit(81)
+(fork-wait) fork returned a pid
+(fork-wait) wait returned 81
+(fork-wait) second wait returned -1
+(fork-wait) end
+fork-wait: exit(0)
+EOF
+pass;
@@ -28,6 +28,7 @@
 #include "userprog/gdt.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
+#include "userprog/aio.h"
 #else
 #include "tests/threads/tests.h"
 #endif
@@ -37,6 +38,10 @@
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/swap.h"
+#endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
@@ -126,6 +131,15 @@ main (void)
   locate_block_devices ();
   filesys_init (format_filesys);
 #endif
+#ifdef VM
+  /* Initialize virtual memory, swap needs the block devices and
+     must be ready before the page-out daemon starts. */
+  swap_pool_init ();
+  frame_table_init ();
+#endif
+#ifdef USERPROG
+  aio_init ();
+#endif
 
   printf ("Boot complete.\n");
   
@@ -259,6 +273,8 @@ parse_options (char **argv)
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+      else if (!strcmp (name, "-sc-stats"))
+        syscall_stats_enabled = true;
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -381,6 +397,7 @@ usage (void)
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+          "  -sc-stats          Print system call statistics at exit.\n"
 #endif
           );
   shutdown_power_off ();
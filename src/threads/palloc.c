@@ -148,6 +148,22 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Returns the first page of the user pool.  The user pool's pages
+   are the PALLOC_USER_PAGE_CNT() pages that follow it, so a frame
+   table can index them by page number. */
+void *
+palloc_user_base (void) 
+{
+  return user_pool.base;
+}
+
+/* Returns the number of pages in the user pool. */
+size_t
+palloc_user_page_cnt (void) 
+{
+  return bitmap_size (user_pool.used_map);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
@@ -243,13 +243,15 @@ thread_create (const char *name, int priority,
     t->exit_code=0;        /*the status code when exit*/
     t->is_user=false;      /*indicator for user thread*/
     t->next_fd_num = 2;    /*fd 0 and 1 is for stdin and stdout*/
+    t->fd_table = NULL;    /*fd_table is allocated by the first open*/
+    t->fd_table_size = 0;
+    t->fd_count = 0;
+    t->aio = NULL;         /*no async I/O ring yet*/
+    t->syscall_stats = NULL;  /*allocated by the first syscall*/
 
     /*init t's child_wait_block_list*/
     list_init(&t->child_wait_block_list);
 
-    /*init t's opened_file_list*/
-    list_init(&t->opened_file_list);
-
     /*alloc wait_info_block*/
     bool success = init_wait_info_block(t);
     /*if failed to init, free the page of t and return error*/
@@ -258,8 +260,6 @@ thread_create (const char *name, int priority,
     		return TID_ERROR;
     }
 #endif
-    /*init the current working directory to root*/
-    t->cwd_sector=ROOT_DIR_SECTOR;
 
   /* Add to run queue. */
   thread_unblock (t);
@@ -618,8 +618,6 @@ init_thread (struct thread *t, const char *name, int priority)
 #endif
 
   t->magic = THREAD_MAGIC;
-  /*init the current working directory to root*/
-  t->cwd_sector=ROOT_DIR_SECTOR;
 
   old_level = intr_disable ();
   list_push_back (&all_list, &t->allelem);
@@ -5,6 +5,10 @@
 #include <list.h>
 #include <stdint.h>
 #include "devices/block.h"
+#ifdef VM
+#include <hash.h>
+#include "threads/synch.h"
+#endif
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -30,6 +34,11 @@ typedef int tid_t;
 
 #define MAX_DIR_PATH 100  /*the upper limit of the length of a path*/
 
+struct dir;
+struct aio_ctx;
+struct file_info_block;
+struct syscall_stats;
+
 /* A kernel thread or user process.
 
    Each thread structure is stored in its own 4 kB page.  The
@@ -128,14 +137,34 @@ struct thread
     struct wait_info_block *wait_info;  /*wait_info_block for this thread*/
     struct list child_wait_block_list;  /*list of wait_info_block of its
     	                                      children*/
-    struct list opened_file_list;       /*list of files this thread opened*/
-    int next_fd_num;                    /*next fd number for this thread*/
+    struct file_info_block **fd_table;  /*files this thread opened, indexed
+                                          by fd, NULL for a free slot*/
+    int fd_table_size;                  /*number of slots in fd_table*/
+    int fd_count;                       /*number of opened files*/
+    int next_fd_num;                    /*lowest fd that may be free*/
     struct file *exec_file_ptr;         /*the file which is the excutable
                                           file for this thread*/
+    struct aio_ctx *aio;                /*async I/O ring state, NULL if
+                                          io_setup was never called*/
+    struct syscall_stats *syscall_stats;/*syscall stats of this process,
+                                          only kept with -sc-stats*/
+#ifdef VM
+    struct hash supplemental_pt;        /*supplemental page table, spte
+                                          of every user page by uaddr*/
+    struct lock supplemental_pt_lock;   /*lock for supplemental_pt*/
+    void *esp;                          /*user esp saved on syscall entry,
+                                          NULL outside of syscalls*/
+    uint8_t *fault_around_next;         /*page a sequential scan faults at
+                                          next, the one after the last
+                                          fault-around*/
+    size_t fault_around_window;         /*pages mapped by the last
+                                          fault-around*/
+#endif
 #endif
 
 
-    block_sector_t cwd_sector;     /*current working directory*/
+    struct dir *cwd;               /*opened current working directory,
+                                     NULL for the root directory*/
 
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
@@ -0,0 +1,379 @@
+#include "userprog/aio.h"
+#include <list.h>
+#include <string.h>
+#include <debug.h>
+#include "userprog/syscall.h"
+#include "userprog/pagedir.h"
+#include "threads/thread.h"
+#include "threads/synch.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+#include "filesys/directory.h"
+#include "filesys/inode.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
+
+#define AIO_WORKERS 4            /* the number of aio worker threads */
+
+/* per-process async I/O state, hung off struct thread */
+struct aio_ctx
+{
+  struct io_ring *ring;          /* user address of the shared ring */
+  uint32_t *pagedir;             /* page dir of the owner process */
+  int inflight;                  /* requests handed to workers and
+                                    not finished yet */
+  struct list done_list;         /* finished requests whose completions
+                                    are not posted to the ring yet */
+  struct lock lock;              /* lock for inflight and done_list */
+  struct condition done;         /* signaled when a request finishes */
+};
+
+/* one submitted operation, owned by a worker while in flight */
+struct aio_request
+{
+  struct aio_ctx *ctx;           /* the submitting process's ctx */
+  struct io_sqe sqe;             /* kernel copy of the submission */
+  struct file *file;             /* reopened file for read/write,
+                                    opened file for open */
+  char *path;                    /* kernel copy of the path for open */
+  char *name;                    /* base name for open, taken over by
+                                    install_opened_file */
+  struct dir *cwd;               /* owner's cwd for a relative open */
+  int result;                    /* result for the completion */
+  bool pinned;                   /* whether the user buffer is pinned */
+  struct list_elem elem;         /* list elem for aio_queue or
+                                    ctx->done_list */
+};
+
+static struct list aio_queue;          /* requests waiting for a worker */
+static struct lock aio_queue_lock;     /* lock for aio_queue */
+static struct condition aio_queue_ready; /* signaled on a new request */
+
+static void aio_worker(void *aux UNUSED);
+static int aio_transfer(struct aio_request *r, bool write);
+static void aio_open(struct aio_request *r);
+static bool aio_prepare(struct aio_ctx *ctx, struct aio_request *r);
+static void aio_free_request(struct aio_request *r);
+
+/* start the pool of aio worker threads */
+void aio_init(void) {
+	int i;
+	lock_init(&aio_queue_lock);
+	list_init(&aio_queue);
+	cond_init(&aio_queue_ready);
+	for (i = 0; i < AIO_WORKERS; i++) {
+		tid_t t = thread_create("aio_worker", PRI_DEFAULT, aio_worker, NULL);
+		if (t == TID_ERROR) {
+			PANIC ("fail to create aio worker");
+		}
+	}
+}
+
+/* register RING, already validated, as the current process's ring.
+ * returns 0 on success, -1 if a ring is registered already */
+int aio_setup(struct io_ring *ring) {
+	struct thread *cur = thread_current();
+	if (cur->aio != NULL) {
+		return -1;
+	}
+	struct aio_ctx *ctx = malloc(sizeof(struct aio_ctx));
+	if (ctx == NULL) {
+		return -1;
+	}
+	ctx->ring = ring;
+	ctx->pagedir = cur->pagedir;
+	ctx->inflight = 0;
+	list_init(&ctx->done_list);
+	lock_init(&ctx->lock);
+	cond_init(&ctx->done);
+
+	ring->sq_head = ring->sq_tail = 0;
+	ring->cq_head = ring->cq_tail = 0;
+	ring->entries = IO_RING_ENTRIES;
+	cur->aio = ctx;
+	return 0;
+}
+
+/* hand up to TO_SUBMIT queued submissions to the workers, then post
+ * finished ones to the completion queue until at least MIN_COMPLETE
+ * are posted, nothing is in flight, or the completion queue is full.
+ * returns the number of submissions taken, or -1 without a ring */
+int aio_enter(unsigned to_submit, unsigned min_complete) {
+	struct aio_ctx *ctx = thread_current()->aio;
+	if (ctx == NULL) {
+		return -1;
+	}
+	struct io_ring *ring = ctx->ring;
+	struct aio_request *r;
+	unsigned submitted = 0;
+	unsigned posted = 0;
+
+	/*take submissions, the indexes are masked with our own constant
+	  so a bad tail can not point outside the ring*/
+	while (submitted < to_submit && ring->sq_head != ring->sq_tail
+			&& ring->sq_tail - ring->sq_head <= IO_RING_ENTRIES) {
+		/*out of memory, leave the rest queued for a later call so
+		  that every submission taken gets a completion*/
+		r = calloc(1, sizeof(struct aio_request));
+		if (r == NULL) {
+			break;
+		}
+		r->sqe = ring->sqes[ring->sq_head % IO_RING_ENTRIES];
+		ring->sq_head++;
+		submitted++;
+
+		if (!aio_prepare(ctx, r)) {
+			continue;
+		}
+		lock_acquire(&ctx->lock);
+		ctx->inflight++;
+		lock_release(&ctx->lock);
+
+		lock_acquire(&aio_queue_lock);
+		list_push_back(&aio_queue, &r->elem);
+		cond_signal(&aio_queue_ready, &aio_queue_lock);
+		lock_release(&aio_queue_lock);
+	}
+
+	/*post completions*/
+	lock_acquire(&ctx->lock);
+	while (ring->cq_tail - ring->cq_head < IO_RING_ENTRIES) {
+		if (list_empty(&ctx->done_list)) {
+			if (posted >= min_complete || ctx->inflight == 0) {
+				break;
+			}
+			cond_wait(&ctx->done, &ctx->lock);
+			continue;
+		}
+		r = list_entry(list_pop_front(&ctx->done_list),
+				struct aio_request, elem);
+		lock_release(&ctx->lock);
+
+		/*a new file gets its fd in the owner*/
+		if (r->sqe.opcode == IO_OP_OPEN && r->file != NULL) {
+			r->result = install_opened_file(r->file, r->name);
+			r->file = NULL;
+			r->name = NULL;
+		}
+		struct io_cqe *cqe = &ring->cqes[ring->cq_tail % IO_RING_ENTRIES];
+		cqe->user_data = r->sqe.user_data;
+		cqe->result = r->result;
+		ring->cq_tail++;
+		posted++;
+		aio_free_request(r);
+
+		lock_acquire(&ctx->lock);
+	}
+	lock_release(&ctx->lock);
+	return submitted;
+}
+
+/* wait for the current process's in-flight requests and drop its
+ * ring, must be called before the page dir is destroyed */
+void aio_exit(void) {
+	struct thread *cur = thread_current();
+	struct aio_ctx *ctx = cur->aio;
+	if (ctx == NULL) {
+		return;
+	}
+	lock_acquire(&ctx->lock);
+	while (ctx->inflight > 0) {
+		cond_wait(&ctx->done, &ctx->lock);
+	}
+	lock_release(&ctx->lock);
+
+	while (!list_empty(&ctx->done_list)) {
+		aio_free_request(list_entry(list_pop_front(&ctx->done_list),
+				struct aio_request, elem));
+	}
+	cur->aio = NULL;
+	free(ctx);
+}
+
+/* validate R's submission in the owner's context and fill in the
+ * rest of R. a bad submission is put on done_list with result -1 and
+ * false is returned, as is done when nothing is left for a worker */
+static bool aio_prepare(struct aio_ctx *ctx, struct aio_request *r) {
+	const struct io_sqe *sqe = &r->sqe;
+	r->ctx = ctx;
+	r->result = -1;
+
+	struct thread *cur = thread_current();
+	struct file_info_block *fib;
+	bool valid = false;
+	switch (sqe->opcode) {
+	case IO_OP_READ:
+	case IO_OP_WRITE:
+		/*only regular files, the worker uses its own file*/
+		fib = find_fib(sqe->fd);
+		if (fib == NULL || fib->f->inode->is_dir || (int) sqe->len < 0
+				|| (int) sqe->offset < 0) {
+			break;
+		}
+		if (sqe->len > 0 && !is_user_address(sqe->buf, sqe->len)) {
+			break;
+		}
+#ifdef VM
+		/*the worker reaches the buffer through the page dir, so it
+		  must stay in memory, and be our own copy if it is to be
+		  written, until the completion is posted*/
+		if (!page_pin_range(sqe->buf, sqe->len,
+				sqe->opcode == IO_OP_READ)) {
+			break;
+		}
+		r->pinned = true;
+#endif
+		r->file = file_reopen(fib->f);
+		valid = r->file != NULL;
+		break;
+	case IO_OP_FSYNC:
+		fib = find_fib(sqe->fd);
+		valid = fib != NULL;
+		break;
+	case IO_OP_OPEN:
+		/*copy the path in one pass, path_to_dir takes no more
+		  than MAX_DIR_PATH anyway*/
+		r->path = malloc(MAX_DIR_PATH);
+		r->name = malloc(NAME_MAX + 1);
+		if (r->path == NULL || r->name == NULL) {
+			break;
+		}
+		int len = strncpy_from_user(r->path, sqe->buf, MAX_DIR_PATH);
+		if (len <= 0 || len == MAX_DIR_PATH) {
+			break;
+		}
+		r->cwd = cur->cwd != NULL ? dir_reopen(cur->cwd) : NULL;
+		valid = true;
+		break;
+	default:
+		break;
+	}
+
+	if (!valid) {
+		lock_acquire(&ctx->lock);
+		list_push_back(&ctx->done_list, &r->elem);
+		lock_release(&ctx->lock);
+		return false;
+	}
+	return true;
+}
+
+/* release whatever R still holds and free it, in the owner's
+ * context */
+static void aio_free_request(struct aio_request *r) {
+#ifdef VM
+	if (r->pinned) {
+		page_unpin_range(r->sqe.buf, r->sqe.len);
+	}
+#endif
+	if (r->file != NULL) {
+		file_close(r->file);
+	}
+	dir_close(r->cwd);
+	free(r->path);
+	free(r->name);
+	free(r);
+}
+
+/* aio worker thread, runs queued requests forever */
+static void aio_worker(void *aux UNUSED) {
+	struct aio_request *r;
+	while (true) {
+		lock_acquire(&aio_queue_lock);
+		while (list_empty(&aio_queue)) {
+			cond_wait(&aio_queue_ready, &aio_queue_lock);
+		}
+		r = list_entry(list_pop_front(&aio_queue), struct aio_request, elem);
+		lock_release(&aio_queue_lock);
+
+		switch (r->sqe.opcode) {
+		case IO_OP_READ:
+			r->result = aio_transfer(r, false);
+			break;
+		case IO_OP_WRITE:
+			r->result = aio_transfer(r, true);
+			break;
+		case IO_OP_FSYNC:
+			/*the buffer cache has no per-file dirty list,
+			  so flush all of it*/
+			inode_flush_cache();
+			r->result = 0;
+			break;
+		case IO_OP_OPEN:
+			aio_open(r);
+			break;
+		default:
+			NOT_REACHED ();
+		}
+		/*read/write are done with the file*/
+		if (r->sqe.opcode != IO_OP_OPEN && r->file != NULL) {
+			file_close(r->file);
+			r->file = NULL;
+		}
+
+		struct aio_ctx *ctx = r->ctx;
+		lock_acquire(&ctx->lock);
+		list_push_back(&ctx->done_list, &r->elem);
+		ctx->inflight--;
+		cond_broadcast(&ctx->done, &ctx->lock);
+		lock_release(&ctx->lock);
+	}
+}
+
+/* move data between R's user buffer and file, a page at a time
+ * through the owner's page dir. returns the bytes moved */
+static int aio_transfer(struct aio_request *r, bool write) {
+	struct inode *inode = file_get_inode(r->file);
+	uint8_t *ubuf = r->sqe.buf;
+	off_t offset = r->sqe.offset;
+	off_t left = r->sqe.len;
+	int bytes = 0;
+
+	/*reads stop at the end of file*/
+	if (!write) {
+		off_t length = inode_length(inode);
+		if (offset >= length) {
+			return 0;
+		}
+		if (left > length - offset) {
+			left = length - offset;
+		}
+	}
+
+	while (left > 0) {
+		off_t page_left = PGSIZE - pg_ofs(ubuf);
+		off_t chunk = left < page_left ? left : page_left;
+		void *kaddr = pagedir_get_page(r->ctx->pagedir, ubuf);
+		if (kaddr == NULL) {
+			break;
+		}
+		off_t done = write ? inode_write_at(inode, kaddr, chunk, offset)
+				: inode_read_at(inode, kaddr, chunk, offset);
+		bytes += done;
+		if (done < chunk) {
+			break;
+		}
+		ubuf += chunk;
+		offset += chunk;
+		left -= chunk;
+	}
+	return bytes;
+}
+
+/* open R's path relative to the owner's cwd, the fd is installed
+ * later by the owner */
+static void aio_open(struct aio_request *r) {
+	struct thread *cur = thread_current();
+	cur->cwd = r->cwd;
+	struct dir *dir = path_to_dir(r->path, r->name);
+	if (dir != NULL) {
+		dir_close(dir);
+		r->file = filesys_open(r->path);
+	}
+	cur->cwd = NULL;
+	/*the result is the fd, filled in by aio_enter*/
+	r->result = -1;
+}
@@ -0,0 +1,11 @@
+#ifndef USERPROG_AIO_H
+#define USERPROG_AIO_H
+
+#include "lib/user/syscall.h"
+
+void aio_init(void);
+int aio_setup(struct io_ring *ring);
+int aio_enter(unsigned to_submit, unsigned min_complete);
+void aio_exit(void);
+
+#endif /* userprog/aio.h */
@@ -4,7 +4,14 @@
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
 #include "userprog/syscall.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
+
+/* Longest faulting instruction a user access fixup skips. */
+#define FIXUP_MAX_INSN_LEN 8
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -152,6 +159,36 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+#ifdef VM
+  /*bring in the page, for the user or for a kernel access to user
+    memory in a syscall. a missing page close enough below the user's
+    esp, which the kernel saved on syscall entry, grows the stack*/
+  if (not_present && is_user_vaddr (fault_addr)
+      && thread_current ()->is_user && thread_current ()->pagedir != NULL
+      && (try_load_page (fault_addr, write)
+          || grow_stack (fault_addr,
+                         user ? f->esp : thread_current ()->esp, write)))
+    return;
+  /*a write to a page shared copy-on-write since a fork*/
+  if (!not_present && write && is_user_vaddr (fault_addr)
+      && thread_current ()->is_user && thread_current ()->pagedir != NULL
+      && page_unshare (fault_addr))
+    return;
+#endif
+
+  /*a kernel fault on a user address comes from get_user() or the
+    user copy primitives in syscall.c, which put the address to
+    resume at, right after the faulting instruction, in eax and
+    look for -1 there*/
+  if (!user && is_user_vaddr (fault_addr)
+      && f->eax > (uint32_t) f->eip
+      && f->eax - (uint32_t) f->eip <= FIXUP_MAX_INSN_LEN)
+    {
+      f->eip = (void (*) (void)) f->eax;
+      f->eax = 0xffffffff;
+      return;
+    }
+
   /*if current thread is a user thread, terminate it with kernel intact*/
   struct thread *cur=thread_current();
   if(cur->is_user){
@@ -29,6 +29,12 @@ static uint64_t make_code_desc (int dpl);
 static uint64_t make_data_desc (int dpl);
 static uint64_t make_tss_desc (void *laddr);
 static uint64_t make_gdtr_operand (uint16_t limit, void *base);
+static bool cpu_has_sysenter (void);
+
+/* Entry point of sysenter, in sysenter.S. */
+void sysenter_entry (void);
+
+bool sysenter_enabled;
 
 /* Sets up a proper GDT.  The bootstrap loader's GDT didn't
    include user-mode selectors or a TSS, but we need both now. */
@@ -51,6 +57,28 @@ gdt_init (void)
   gdtr_operand = make_gdtr_operand (sizeof gdt - 1, gdt);
   asm volatile ("lgdt %0" : : "m" (gdtr_operand));
   asm volatile ("ltr %w0" : : "q" (SEL_TSS));
+
+  /* Set up the sysenter fast system call path, if the CPU has
+     it.  The int $0x30 gate stays registered either way.  The
+     stack pointer MSR tracks the running thread, so it is written
+     by tss_update(). */
+  if (cpu_has_sysenter ())
+    {
+      wrmsr (MSR_SYSENTER_CS, SEL_KCSEG);
+      wrmsr (MSR_SYSENTER_EIP, (uint32_t) sysenter_entry);
+      sysenter_enabled = true;
+      tss_update ();
+    }
+}
+
+/* Returns true if CPUID reports the SEP feature, that is, the
+   sysenter and sysexit instructions.  See [IA32-v2a] "CPUID". */
+static bool
+cpu_has_sysenter (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+  asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+  return (edx & (1 << 11)) != 0;
 }
 
 /* System segment or code/data segment? */
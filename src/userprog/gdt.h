@@ -10,6 +10,30 @@
 #define SEL_TSS         0x28    /* Task-state segment. */
 #define SEL_CNT         6       /* Number of segments. */
 
+/* Model-specific registers for the sysenter instruction.  See
+   [IA32-v3a] 4.8.7 "Performing Fast Calls to System Procedures
+   with the SYSENTER and SYSEXIT Instructions".  sysexit returns
+   to SYSENTER_CS + 16 and SYSENTER_CS + 24, which with
+   SEL_KCSEG is exactly SEL_UCSEG and SEL_UDSEG. */
+#define MSR_SYSENTER_CS  0x174  /* Kernel code selector. */
+#define MSR_SYSENTER_ESP 0x175  /* Kernel stack pointer. */
+#define MSR_SYSENTER_EIP 0x176  /* Kernel entry point. */
+
+#ifndef __ASSEMBLER__
+#include <stdbool.h>
+#include <stdint.h>
+
+/* True if the CPU has sysenter and it is set up. */
+extern bool sysenter_enabled;
+
 void gdt_init (void);
 
+/* Writes VALUE to model-specific register MSR. */
+static inline void
+wrmsr (uint32_t msr, uint32_t value)
+{
+  asm volatile ("wrmsr" : : "c" (msr), "a" (value), "d" (0));
+}
+#endif
+
 #endif /* userprog/gdt.h */
@@ -214,6 +214,24 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
     }
 }
 
+/* Sets the writable bit to WRITABLE in the PTE for virtual page
+   VPAGE in PD, keeping the page mapped to the same frame.  Used to
+   share a frame copy-on-write and to give it back to the last
+   owner. */
+void
+pagedir_set_writable (uint32_t *pd, const void *vpage, bool writable) 
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  if (pte != NULL && (*pte & PTE_P) != 0) 
+    {
+      if (writable)
+        *pte |= PTE_W;
+      else 
+        *pte &= ~(uint32_t) PTE_W;
+      invalidate_pagedir (pd);
+    }
+}
+
 /* Loads page directory PD into the CPU's page directory base
    register. */
 void
@@ -250,14 +268,17 @@ active_pd (void)
 
    This function invalidates the TLB if PD is the active page
    directory.  (If PD is not active then its entries are not in
-   the TLB, so there is no need to invalidate anything.) */
+   the TLB, so there is no need to invalidate anything.)  The
+   kernel's page tables in init_page_dir are shared by every page
+   directory, so changing them invalidates the active one. */
 static void
 invalidate_pagedir (uint32_t *pd) 
 {
-  if (active_pd () == pd) 
+  uint32_t *active = active_pd ();
+  if (active == pd || pd == init_page_dir) 
     {
       /* Re-activating PD clears the TLB.  See [IA32-v3a] 3.12
          "Translation Lookaside Buffers (TLBs)". */
-      pagedir_activate (pd);
+      pagedir_activate (active);
     } 
 }
@@ -9,6 +9,7 @@
 #include "userprog/pagedir.h"
 #include "userprog/tss.h"
 #include "userprog/syscall.h"
+#include "userprog/aio.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
@@ -19,8 +20,14 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "threads/malloc.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 static thread_func start_process NO_RETURN;
+#ifdef VM
+static thread_func start_fork NO_RETURN;
+#endif
 static bool load (void *lib_, void (**eip) (void), void **esp);
 
 /*self defined*/
@@ -54,6 +61,9 @@ process_execute (const char *file_name)
   lib->full_line = fn_copy;
   sema_init(&lib->sema_loaded, 0);
   lib->success = false;
+  /*the child starts in the parent's cwd*/
+  struct dir *cwd = thread_current()->cwd;
+  lib->cwd = cwd != NULL ? dir_reopen(cwd) : NULL;
 
   /* Create a new thread to execute FILE_NAME. */
   tid = thread_create (fn_copy, PRI_DEFAULT, start_process, lib);
@@ -69,6 +79,8 @@ process_execute (const char *file_name)
   if(lib->full_line!=NULL){
 	  palloc_free_page(lib->full_line);
   }
+  /*close the cwd if the child did not take it over*/
+  dir_close(lib->cwd);
   free(lib);
 
   return tid;
@@ -87,6 +99,10 @@ start_process (void *lib_)
   /*update is_user flag to true: it is a user process*/
   cur->is_user=true;
 
+  /*take over the cwd inherited from the parent*/
+  cur->cwd = lib->cwd;
+  lib->cwd = NULL;
+
   /* Initialize interrupt frame and load executable. */
   memset (&if_, 0, sizeof if_);
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
@@ -112,6 +128,89 @@ start_process (void *lib_)
   NOT_REACHED ();
 }
 
+/* Starts a new thread running a copy of the current user process,
+   which is in a system call with frame F.  The child's memory is
+   shared copy-on-write with ours, it gets its own handle of each
+   open file and of the cwd, and it returns 0 from the same system
+   call.  Returns the child's thread id, or TID_ERROR if it cannot
+   be created. */
+tid_t
+process_fork (const struct intr_frame *f)
+{
+#ifdef VM
+  struct thread *cur = thread_current ();
+  tid_t tid;
+
+  struct fork_info_block *fkib = malloc (sizeof (struct fork_info_block));
+  if (fkib == NULL)
+    return TID_ERROR;
+  fkib->parent = cur;
+  fkib->if_ = *f;
+  sema_init (&fkib->sema_forked, 0);
+  fkib->success = false;
+
+  tid = thread_create (cur->name, PRI_DEFAULT, start_fork, fkib);
+
+  /*wait for the child to copy us, we must not change meanwhile*/
+  if (tid != TID_ERROR)
+    sema_down (&fkib->sema_forked);
+  if (!fkib->success)
+    tid = TID_ERROR;
+
+  free (fkib);
+  return tid;
+#else
+  /*only the supplemental page table knows the pages to copy*/
+  (void) f;
+  return TID_ERROR;
+#endif
+}
+
+#ifdef VM
+/* A thread function that copies the user process blocked in
+   process_fork() and starts it running. */
+static void
+start_fork (void *fkib_)
+{
+  struct fork_info_block *fkib = (struct fork_info_block *) fkib_;
+  struct thread *parent = fkib->parent;
+  struct thread *cur = thread_current ();
+  struct intr_frame if_ = fkib->if_;
+  bool success = false;
+
+  cur->is_user = true;
+  cur->cwd = parent->cwd != NULL ? dir_reopen (parent->cwd) : NULL;
+
+  cur->pagedir = pagedir_create ();
+  if (cur->pagedir == NULL || !page_table_init ())
+    goto done;
+  process_activate ();
+
+  /*our own handle of the executable, the text frames are found by
+    its inode and shared with the parent*/
+  cur->exec_file_ptr = file_reopen (parent->exec_file_ptr);
+  if (cur->exec_file_ptr == NULL)
+    goto done;
+  file_deny_write (cur->exec_file_ptr);
+
+  success = fork_fd_table (parent) && page_table_fork (parent);
+
+ done:
+  fkib->success = success;
+  /*notice the waiting parent thread, fkib is gone after this*/
+  sema_up (&fkib->sema_forked);
+
+  if (!success) {
+	cur->exit_code = -1;
+    thread_exit ();
+  }
+  /*return to user mode from the parent's system call, with 0*/
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+#endif
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -180,6 +279,14 @@ process_exit (void)
   uint32_t *pd;
   char cmd[MAX_FILE_NAME+2];
 
+  /*wait for in-flight async I/O, it still uses the page directory*/
+  aio_exit ();
+
+#ifdef VM
+  /*free all user pages while the page dir and exec_file are alive*/
+  page_table_destroy ();
+#endif
+
   /*close exec_file and allow to write it again*/
   if(cur->exec_file_ptr!=NULL){
 	  file_allow_write(cur->exec_file_ptr);
@@ -187,24 +294,30 @@ process_exit (void)
 	  cur->exec_file_ptr=NULL;
   }
 
-  /*close all opened files of this thread*/
-  struct list *opened_files = &cur->opened_file_list;
-  struct list_elem *e = list_begin (opened_files);
-  struct list_elem *temp = NULL;
-  struct file_info_block *fib;
-
-  while (e != list_end (opened_files)){
-	  temp = list_next (e);
-	  fib = list_entry (e, struct file_info_block, elem);
-	  close_file_by_fib(fib);
-	  e = temp;
+  /*close all opened files of this thread, stop at the last one*/
+  int fd;
+  for (fd = 0; cur->fd_count > 0 && fd < cur->fd_table_size; fd++){
+	  if (cur->fd_table[fd] != NULL){
+		  close_file_by_fib(cur->fd_table[fd]);
+	  }
   }
+  free (cur->fd_table);
+  cur->fd_table = NULL;
+  cur->fd_table_size = 0;
+
+  /*close the current working directory*/
+  dir_close (cur->cwd);
+  cur->cwd = NULL;
 
   /*print out termination msg for grading use*/
   if (cur->is_user){
 	get_cmd(cur->name, cmd);
 	printf ("%s: exit(%d)\n", cmd, cur->exit_code);
+	if (cur->syscall_stats != NULL)
+	  syscall_print_process_stats (cmd, cur->syscall_stats);
   }
+  free (cur->syscall_stats);
+  cur->syscall_stats = NULL;
 
 
   /*update wait_info_block if its parent process still exists*/
@@ -249,11 +362,6 @@ process_exit (void)
       pagedir_destroy (pd);
     }
 
-  /*if this about to exit process is holding the filesys_lock, release it*/
-  if(lock_held_by_current_thread (&global_file_list_lock)){
-	  lock_release(&global_file_list_lock);
-  }
-
 }
 
 /* Sets up the CPU for running user code in the current
@@ -366,6 +474,10 @@ load (void *lib_, void (**eip) (void), void **esp)
   if (t->pagedir == NULL) 
     goto done;
   process_activate ();
+#ifdef VM
+  if (!page_table_init ())
+    goto done;
+#endif
 
   /* Open executable file. */
   file = filesys_open (file_name);
@@ -470,8 +582,6 @@ load (void *lib_, void (**eip) (void), void **esp)
 
 /* load() helpers. */
 
-static bool install_page (void *upage, void *kpage, bool writable);
-
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
 static bool
@@ -530,7 +640,11 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    user process if WRITABLE is true, read-only otherwise.
 
    Return true if successful, false if a memory allocation error
-   or disk read error occurs. */
+   or disk read error occurs.
+
+   With VM, the pages are only recorded in the supplemental page
+   table here, and each is read in by try_load_page() when it is
+   first touched. */
 static bool
 load_segment (struct file *file, off_t ofs, uint8_t *upage,
               uint32_t read_bytes, uint32_t zero_bytes, bool writable) 
@@ -539,6 +653,22 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
+#ifdef VM
+  while (read_bytes > 0 || zero_bytes > 0) 
+    {
+      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
+      size_t page_zero_bytes = PGSIZE - page_read_bytes;
+
+      if (!page_add_file (file, ofs, upage, page_read_bytes, writable))
+        return false;
+
+      read_bytes -= page_read_bytes;
+      zero_bytes -= page_zero_bytes;
+      ofs += page_read_bytes;
+      upage += PGSIZE;
+    }
+  return true;
+#else
   file_seek (file, ofs);
   while (read_bytes > 0 || zero_bytes > 0) 
     {
@@ -574,6 +704,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       upage += PGSIZE;
     }
   return true;
+#endif
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
@@ -581,10 +712,17 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 static bool
 setup_stack (void **esp) 
 {
-  uint8_t *kpage;
   bool success = false;
 
-  kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+#ifdef VM
+  /* The stack page is recorded like one grown on a fault, then
+     brought in at once since the arguments go there next. */
+  uint8_t *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
+  success = grow_stack (upage, upage, true);
+  if (success)
+    *esp = PHYS_BASE;
+#else
+  uint8_t *kpage = palloc_get_page (PAL_USER | PAL_ZERO);
   if (kpage != NULL) 
     {
       success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
@@ -593,6 +731,7 @@ setup_stack (void **esp)
       else
         palloc_free_page (kpage);
     }
+#endif
   return success;
 }
 
@@ -605,7 +744,7 @@ setup_stack (void **esp)
    with palloc_get_page().
    Returns true on success, false if UPAGE is already mapped or
    if memory allocation fails. */
-static bool
+bool
 install_page (void *upage, void *kpage, bool writable)
 {
   struct thread *t = thread_current ();
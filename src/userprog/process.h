@@ -3,6 +3,7 @@
 
 #include "threads/thread.h"
 #include "threads/synch.h"
+#include "threads/interrupt.h"
 
 /*info used for process waiting*/
 struct wait_info_block {
@@ -19,12 +20,26 @@ struct load_info_block {
 	char * full_line;               /*full command line string*/
 	struct semaphore sema_loaded;   /*semaphore used to load thread*/
 	bool success;              /*whether the thread is loaded successfully*/
+	struct dir *cwd;           /*reopened cwd of the parent, taken over
+	                             by the child*/
+};
+
+/*fork info struct used for process_fork*/
+struct fork_info_block {
+	struct thread *parent;          /*the forking thread, blocked until
+	                                  the child signals sema_forked*/
+	struct intr_frame if_;          /*parent's syscall frame, the child
+	                                  returns from a copy of it*/
+	struct semaphore sema_forked;   /*semaphore used to fork thread*/
+	bool success;              /*whether the child is set up successfully*/
 };
 
 tid_t process_execute (const char *file_name);
+tid_t process_fork (const struct intr_frame *f);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
+bool install_page (void *upage, void *kpage, bool writable);
 
 /*self defined*/
 #define MAX_FILE_NAME 14
@@ -1,7 +1,9 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
+#include <inttypes.h>
 #include <syscall-nr.h>
 #include <string.h>
+#include <hash.h>
 #include "lib/user/syscall.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
@@ -17,12 +19,21 @@
 #include "lib/string.h"
 #include "devices/shutdown.h"
 #include "devices/input.h"
+#include "devices/intq.h"
 #include "filesys/cache.h"
+#include "filesys/dcache.h"
+#include "threads/palloc.h"
+#include "userprog/aio.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 
 
 static void syscall_handler (struct intr_frame *);
 static int get_user (const uint8_t *uaddr);
+static size_t copy_user (void *dst, const void *src, size_t size);
+static bool is_user_range(const void *uaddr, size_t size);
 
 
 /*info for opened files in the entire system*/
@@ -31,21 +42,57 @@ struct global_file_block {
 	int ref_num;                   /*the number of threads holding this
 									file*/
 	bool is_deleted;               /*indicates the file is to be removed*/
-	struct list_elem elem;         /*list elem for global_file_list*/
+	struct list_elem elem;         /*list elem for its gfb_bucket*/
 	struct lock lock;
 };
 
-struct list global_file_list;      /*List of all opened files*/
+#define GFB_BUCKETS 64             /*buckets in global_file_table*/
+
+/*a bucket of global_file_table, holding the global_file_blocks
+ * whose sectors hash to it*/
+struct gfb_bucket {
+	struct list list;              /*global_file_blocks in this bucket*/
+	struct lock lock;              /*lock for list, so opens and closes of
+	                                 files in other buckets run in parallel*/
+};
+
+/*all opened files in the system, hashed by inode sector*/
+static struct gfb_bucket global_file_table[GFB_BUCKETS];
+
+#define FD_TABLE_INIT_SIZE 16      /*slots in a thread's first fd_table*/
+
+bool syscall_stats_enabled;        /*-sc-stats kernel command line option*/
+static struct syscall_stats global_syscall_stats; /*system-wide stats*/
+
+/*names of the system calls, for printing stats*/
+static const char *syscall_names[SYS_CNT] = {
+	"halt", "exit", "exec", "wait", "create", "remove", "open",
+	"filesize", "read", "write", "seek", "tell", "close",
+	"mmap", "munmap",
+	"chdir", "mkdir", "readdir", "isdir", "inumber",
+	"getdents", "pread", "pwrite", "readv", "writev",
+	"copy_file_range", "io_setup", "io_enter", "batch", "fork",
+};
 
 
-static bool is_user_address(const void *pointer, int size);
-static bool is_string_address_valid(const void *pointer);
 static bool is_page_mapped (const void *uaddr_);
-static struct file_info_block* find_fib(struct list* l, int fd);
+static int alloc_fd(struct thread *t);
+static void free_fd(struct thread *t, int fd);
+static struct gfb_bucket *gfb_bucket_of(block_sector_t s);
 static struct global_file_block *find_opened_file(
-		struct list *l, block_sector_t s);
+		struct gfb_bucket *bucket, block_sector_t s);
+static void release_opened_file(struct file *file, const char *file_name);
+static char *copy_in_string(const char *ustr);
+static bool change_dir(const char *dir);
+static bool remove_file(const char *file_name);
+static int open_file(const char *file_name);
 static int write_to_file(struct file *file, char *buffer, size_t size);
 static int read_from_file(struct file* f, void *buffer, int size);
+static void pin_user_buffer(const void *buffer, size_t size, bool write);
+static void unpin_user_buffer(const void *buffer, size_t size);
+static void pin_iovec(const struct iovec *iov, int cnt, bool write);
+static void unpin_iovec(const struct iovec *iov, int cnt);
+static int read_from_console(char *ubuf, int size, bool *line_end);
 static void sys_exit_handler(struct intr_frame *f);
 static void sys_halt_handler(struct intr_frame *f);
 static void sys_exec_handler(struct intr_frame *f);
@@ -64,14 +111,34 @@ static void sys_mkdir_handler(struct intr_frame *f);
 static void sys_readdir_handler(struct intr_frame *f);
 static void sys_isdir_handler(struct intr_frame *f);
 static void sys_inumber_handler(struct intr_frame *f);
+static void sys_getdents_handler(struct intr_frame *f);
+static void sys_pread_handler(struct intr_frame *f);
+static void sys_pwrite_handler(struct intr_frame *f);
+static void sys_readv_handler(struct intr_frame *f);
+static void sys_writev_handler(struct intr_frame *f);
+static bool is_iovec_valid(const struct iovec *iov, int iovcnt,
+		bool *too_long);
+static void sys_copy_file_range_handler(struct intr_frame *f);
+static void sys_io_setup_handler(struct intr_frame *f);
+static void sys_io_enter_handler(struct intr_frame *f);
+static void sys_batch_handler(struct intr_frame *f);
+static bool batch_failed(int number, int result);
+static void sys_fork_handler(struct intr_frame *f);
+static uint64_t syscall_stats_begin(int nr);
+static void syscall_stats_end(int nr, uint64_t start);
+static void syscall_stats_add(struct syscall_stats *stats, int nr,
+		uint64_t cycles);
 
 
 void
 syscall_init (void) 
 {
-  /*init the global file list and filesys locl*/
-  lock_init(&global_file_list_lock);
-  list_init(&global_file_list);
+  /*init the global file table*/
+  int i;
+  for (i = 0; i < GFB_BUCKETS; i++) {
+	  list_init(&global_file_table[i].list);
+	  lock_init(&global_file_table[i].lock);
+  }
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 }
 
@@ -79,15 +146,26 @@ static void
 syscall_handler (struct intr_frame *f UNUSED) 
 {
  uint32_t* esp=f->esp;
+#ifdef VM
+ /*save the user esp for stack growth on kernel page faults, a call
+   nested in batch keeps the one of the outer call*/
+ struct thread *cur = thread_current();
+ bool outer_call = cur->esp == NULL;
+ if (outer_call) {
+	 cur->esp = esp;
+ }
+#endif
  if(!is_user_address((void*)esp, sizeof(void *))){
 	 user_exit(-1);
  }
 
  /*get system call number*/
  int *sys_call_num = (int*)esp;
+ int nr = *sys_call_num;
+ uint64_t start = syscall_stats_begin(nr);
 
  /*switch to specfic system call handler*/
- switch(*sys_call_num){
+ switch(nr){
 	case SYS_HALT:
 		sys_halt_handler(f);
 		break;
@@ -142,12 +220,141 @@ syscall_handler (struct intr_frame *f UNUSED)
 	case SYS_INUMBER:
 		sys_inumber_handler(f);
 		break;
+	case SYS_GETDENTS:
+		sys_getdents_handler(f);
+		break;
+	case SYS_PREAD:
+		sys_pread_handler(f);
+		break;
+	case SYS_PWRITE:
+		sys_pwrite_handler(f);
+		break;
+	case SYS_READV:
+		sys_readv_handler(f);
+		break;
+	case SYS_WRITEV:
+		sys_writev_handler(f);
+		break;
+	case SYS_COPY_FILE_RANGE:
+		sys_copy_file_range_handler(f);
+		break;
+	case SYS_IO_SETUP:
+		sys_io_setup_handler(f);
+		break;
+	case SYS_IO_ENTER:
+		sys_io_enter_handler(f);
+		break;
+	case SYS_BATCH:
+		sys_batch_handler(f);
+		break;
+	case SYS_FORK:
+		sys_fork_handler(f);
+		break;
 	default:break;
  }
 
+ syscall_stats_end(nr, start);
+#ifdef VM
+ if (outer_call) {
+	 cur->esp = NULL;
+ }
+#endif
 }
 
 
+/*read the CPU time-stamp counter*/
+static inline uint64_t rdtsc(void) {
+	uint64_t tsc;
+	asm volatile ("rdtsc" : "=A" (tsc));
+	return tsc;
+}
+
+/*count a call to syscall NR, and return the TSC it started at.
+ * counted up front so calls that never return, like exit, show up*/
+static uint64_t syscall_stats_begin(int nr) {
+	if (nr < 0 || nr >= SYS_CNT) {
+		return 0;
+	}
+	struct thread *cur = thread_current();
+	if (syscall_stats_enabled && cur->syscall_stats == NULL) {
+		cur->syscall_stats = calloc(1, sizeof(struct syscall_stats));
+	}
+	if (cur->syscall_stats != NULL) {
+		cur->syscall_stats->count[nr]++;
+	}
+	enum intr_level old_level = intr_disable();
+	global_syscall_stats.count[nr]++;
+	intr_set_level(old_level);
+	return rdtsc();
+}
+
+/*add the latency of a call to syscall NR started at START*/
+static void syscall_stats_end(int nr, uint64_t start) {
+	if (nr < 0 || nr >= SYS_CNT) {
+		return;
+	}
+	uint64_t cycles = rdtsc() - start;
+	struct thread *cur = thread_current();
+	if (cur->syscall_stats != NULL) {
+		syscall_stats_add(cur->syscall_stats, nr, cycles);
+	}
+	/*other processes update the global stats too*/
+	enum intr_level old_level = intr_disable();
+	syscall_stats_add(&global_syscall_stats, nr, cycles);
+	intr_set_level(old_level);
+}
+
+/*add CYCLES to the latency of syscall NR in STATS*/
+static void syscall_stats_add(struct syscall_stats *stats, int nr,
+		uint64_t cycles) {
+	int bucket = 0;
+	while (bucket < SYSCALL_HIST_BUCKETS - 1
+			&& cycles >> (bucket + SYSCALL_HIST_SHIFT + 1) != 0) {
+		bucket++;
+	}
+	stats->cycles[nr] += cycles;
+	stats->hist[nr][bucket]++;
+}
+
+/*print the stats of every syscall made in STATS, headed by NAME*/
+void syscall_print_process_stats(const char *name,
+		const struct syscall_stats *stats) {
+	int nr, i;
+	printf("%s: syscall stats\n", name);
+	for (nr = 0; nr < SYS_CNT; nr++) {
+		if (stats->count[nr] == 0) {
+			continue;
+		}
+		/*exit, and calls cut short by it, never finish*/
+		uint32_t finished = 0;
+		for (i = 0; i < SYSCALL_HIST_BUCKETS; i++) {
+			finished += stats->hist[nr][i];
+		}
+		printf("  %-16s %8"PRIu32" calls", syscall_names[nr], stats->count[nr]);
+		if (finished > 0) {
+			printf(" %10"PRIu64" cycles avg, log2 histogram from 2^%d:",
+					stats->cycles[nr] / finished, SYSCALL_HIST_SHIFT);
+			for (i = 0; i < SYSCALL_HIST_BUCKETS; i++) {
+				printf(" %"PRIu32, stats->hist[nr][i]);
+			}
+		}
+		printf("\n");
+	}
+}
+
+/*print system-wide syscall stats, detailed with -sc-stats*/
+void syscall_print_stats(void) {
+	uint64_t total = 0;
+	int nr;
+	for (nr = 0; nr < SYS_CNT; nr++) {
+		total += global_syscall_stats.count[nr];
+	}
+	printf("Syscall: %"PRIu64" calls\n", total);
+	if (syscall_stats_enabled) {
+		syscall_print_process_stats("Syscall", &global_syscall_stats);
+	}
+}
+
 /*handle sys_inumber*/
 static void sys_inumber_handler(struct intr_frame *f){
 	uint32_t* esp=f->esp;
@@ -166,7 +373,7 @@ static void sys_inumber_handler(struct intr_frame *f){
 	} else {
 		/*read from regular file*/
 		struct file_info_block *fib =
-				find_fib(&thread_current()->opened_file_list, *fd_ptr);
+				find_fib(*fd_ptr);
 		if (fib == NULL) {
 			f->eax = INVALID_SECTOR_ID;
 		} else {
@@ -195,7 +402,7 @@ static void sys_isdir_handler(struct intr_frame *f){
 	} else {
 		/*read from regular file*/
 		struct file_info_block *fib =
-				find_fib(&thread_current()->opened_file_list, *fd_ptr);
+				find_fib(*fd_ptr);
 		if (fib == NULL) {
 			f->eax = false;
 		} else {
@@ -239,7 +446,7 @@ static void sys_readdir_handler(struct intr_frame *f){
 	} else {
 		/*read from regular file*/
 		struct file_info_block *fib =
-				find_fib(&thread_current()->opened_file_list, *fd_ptr);
+				find_fib(*fd_ptr);
 		if (fib == NULL) {
 			f->eax = false;
 		} else {
@@ -259,6 +466,83 @@ static void sys_readdir_handler(struct intr_frame *f){
 }
 
 
+/*handle sys_getdents*/
+static void sys_getdents_handler(struct intr_frame *f){
+	uint32_t* esp=f->esp;
+	/*validate the 1st argument*/
+	if(!is_user_address(esp+1, sizeof(int))){
+		 /* exit with -1*/
+		 user_exit(-1);
+		 return;
+	}
+	/*validate the 2nd argument*/
+	if(!is_user_address(esp+2, sizeof(void **))){
+		 /* exit with -1*/
+		 user_exit(-1);
+		 return;
+	}
+	/*validate the 3rd argument*/
+	if(!is_user_address(esp+3, sizeof(unsigned))){
+		 /* exit with -1*/
+		 user_exit(-1);
+		 return;
+	}
+
+	int *fd_ptr=(int *)(esp+1);
+	struct dirent *entries=*(struct dirent **)(esp+2);
+	unsigned max_entries=*(unsigned *)(esp+3);
+
+	if (max_entries == 0) {
+		f->eax = 0;
+		return;
+	}
+	/*clamp to a page worth of user entries per call*/
+	if (max_entries > PGSIZE / sizeof(struct dirent)) {
+		max_entries = PGSIZE / sizeof(struct dirent);
+	}
+
+	/*verify whole buffer*/
+	if(!is_user_address((void *)entries,
+			max_entries * sizeof(struct dirent))){
+		user_exit(-1);
+		return;
+	}
+
+	struct file_info_block *fib =
+			find_fib(*fd_ptr);
+	if (fib == NULL || !fib->f->inode->is_dir) {
+		f->eax = -1;
+		return;
+	}
+
+	struct dir_entry *batch = malloc(max_entries * sizeof *batch);
+	if (batch == NULL) {
+		f->eax = -1;
+		return;
+	}
+	struct dir *d = dir_open(inode_reopen(fib->f->inode));
+	if (d == NULL) {
+		free(batch);
+		f->eax = -1;
+		return;
+	}
+	d->pos = fib->f->pos;
+	int cnt = dir_readdir_batch(d, batch, max_entries);
+	fib->f->pos = d->pos;
+	dir_close(d);
+
+	/*pack the entries into the user buffer*/
+	int i;
+	for (i = 0; i < cnt; i++) {
+		entries[i].inumber = batch[i].inode_sector;
+		entries[i].is_dir = batch[i].is_dir;
+		strlcpy(entries[i].name, batch[i].name, sizeof entries[i].name);
+	}
+	free(batch);
+	f->eax = cnt;
+}
+
+
 /*handle sys_mkdir*/
 static void sys_mkdir_handler(struct intr_frame *f){
 	uint32_t* esp=f->esp;
@@ -269,16 +553,15 @@ static void sys_mkdir_handler(struct intr_frame *f){
 		 return;
 	}
 
-	/*get the dir name*/
-	char *dir=*(char **)(esp+1);
-
-	/*verify string address*/
-	if(!is_string_address_valid(dir)){
-		user_exit(-1);
+	/*copy in the dir name*/
+	char *dir = copy_in_string(*(char **)(esp+1));
+	if (dir == NULL) {
+		f->eax = false;
 		return;
 	}
 
 	f->eax = filesys_mkdir(dir);
+	palloc_free_page(dir);
 }
 
 
@@ -293,56 +576,59 @@ static void sys_chdir_handler(struct intr_frame *f){
 		 return;
 	}
 
-	/*get the dir name*/
-	char *dir=*(char **)(esp+1);
-
-	/*verify string address*/
-	if(!is_string_address_valid(dir)){
-		user_exit(-1);
+	/*copy in the dir name*/
+	char *dir = copy_in_string(*(char **)(esp+1));
+	if (dir == NULL) {
+		f->eax = false;
 		return;
 	}
 
+	f->eax = change_dir(dir);
+	palloc_free_page(dir);
+}
 
-	if (dir == NULL || strlen(dir) == 0) {
-		f->eax = false;
-		return;
+/*make DIR, a kernel copy of the path, the current thread's cwd.
+ * return false if it is not an existing directory*/
+static bool change_dir(const char *dir){
+	if (strlen(dir) == 0) {
+		return false;
 	}
 	  struct inode *inode = NULL;
 	  struct dir *d = NULL;
 	  char name_to_open[NAME_MAX + 1];
 
-	  d = path_to_dir(dir,name_to_open);
+	  d = path_to_dir((char *) dir,name_to_open);
 
 	  if(d==NULL){
-		  f->eax = false;
-		  return;
+		  return false;
 	  }
 
-	  /*if open root, file open the root*/
+	  struct thread *cur = thread_current();
+	  /*if open root, switch the cwd to root*/
 	  if(strlen(name_to_open)==0){
-		thread_current()->cwd_sector=ROOT_DIR_SECTOR;
-		f->eax = true;
+		dir_close (cur->cwd);
+		cur->cwd = NULL;
 		dir_close (d);
-	  }else{
-		  ASSERT (name_to_open != NULL && strlen(name_to_open) > 0);
-		  dir_lookup (d, name_to_open, &inode);
-		  if (inode == NULL) {
-			  dir_close (d);
-			  f->eax = false;
-			  return;
-		  }
-		  if (inode->removed) {
-			  dir_close (d);
-			  inode_close(inode);
-			  f->eax = false;
-			  return;
-		  }
-		  thread_current()->cwd_sector=inode->sector;
-		  inode_close(inode);
-		  f->eax=true;
-		  dir_close (d);
+		return true;
 	  }
 
+	  dir_lookup (d, name_to_open, &inode);
+	  dir_close (d);
+	  if (inode == NULL) {
+		  return false;
+	  }
+	  if (inode->removed || !inode->is_dir) {
+		  inode_close(inode);
+		  return false;
+	  }
+	  /*keep the new cwd open, dir_open takes over the inode*/
+	  struct dir *new_cwd = dir_open(inode);
+	  if (new_cwd == NULL) {
+		  return false;
+	  }
+	  dir_close (cur->cwd);
+	  cur->cwd = new_cwd;
+	  return true;
 }
 
 /*handle sys_exec*/
@@ -355,17 +641,16 @@ static void sys_exec_handler(struct intr_frame *f){
 		 return;
 	 }
 
-	/*get the full_line command*/
-	char *full_line=*(char **)(esp+1);
-
-	/*verify string address*/
-	if(!is_string_address_valid(full_line)){
-		user_exit(-1);
+	/*copy in the full_line command*/
+	char *full_line = copy_in_string(*(char **)(esp+1));
+	if (full_line == NULL) {
+		f->eax = -1;
 		return;
 	}
 
 	/*execute*/
 	tid_t tid=process_execute(full_line);
+	palloc_free_page(full_line);
 	/*handle return value*/
 	if(tid==TID_ERROR){
 		f->eax=-1;
@@ -385,44 +670,50 @@ static void sys_remove_handler(struct intr_frame *f){
 		 return;
 	}
 
-	/*get the full_line command*/
-	char *file_name=*(char **)(esp+1);
-
-	/*verify string address*/
-	if(!is_string_address_valid(file_name)){
-		user_exit(-1);
+	/*copy in the file name*/
+	char *file_name = copy_in_string(*(char **)(esp+1));
+	if (file_name == NULL) {
+		f->eax = false;
 		return;
 	}
 
+	f->eax = remove_file(file_name);
+	palloc_free_page(file_name);
+}
+
+/*remove FILE_NAME, a kernel copy of the path. a file still open is
+ * only marked, and removed by its last close. return false if it
+ * does not exist*/
+static bool remove_file(const char *file_name){
 	struct file *file = filesys_open(file_name);
 	/*return false if failed to open the file*/
 	if (file == NULL) {
-		f->eax = false;
-		return;
+		return false;
 	}
 
 	/*update the global_file_block*/
-	ASSERT(!lock_held_by_current_thread (&global_file_list_lock));
-	lock_acquire(&global_file_list_lock);
-	struct global_file_block *gfb = find_opened_file(&global_file_list,
+	struct gfb_bucket *bucket = gfb_bucket_of(file->inode->sector);
+	lock_acquire(&bucket->lock);
+	struct global_file_block *gfb = find_opened_file(bucket,
 			file->inode->sector);
 	if (gfb != NULL) {
 		ASSERT (!lock_held_by_current_thread (&gfb->lock));
 		lock_acquire(&gfb->lock);
 	}
-	lock_release(&global_file_list_lock);
+	lock_release(&bucket->lock);
 
 	/*if not find, return, since this file is not opened*/
 	if (gfb == NULL) {
-		f->eax =filesys_remove(file_name);
-	} else {
-		ASSERT (lock_held_by_current_thread (&gfb->lock));
-		/*mark as deleted*/
-		gfb->is_deleted=true;
-		lock_release(&gfb->lock);
-		file->inode->removed = true;
-		f->eax = true;
+		return filesys_remove(file_name);
 	}
+	ASSERT (lock_held_by_current_thread (&gfb->lock));
+	/*mark as deleted*/
+	gfb->is_deleted=true;
+	lock_release(&gfb->lock);
+	file->inode->removed = true;
+	/*the name must no longer resolve through the name cache*/
+	dcache_invalidate_sector(file->inode->sector);
+	return true;
 }
 
 /*handle sys_close*/
@@ -438,8 +729,7 @@ static void sys_close_handler(struct intr_frame *f){
 	/*get the full_line command*/
 	int *fd_ptr=(int *)(esp+1);
 
-	struct thread * cur=thread_current();
-	struct file_info_block*fib = find_fib(&cur->opened_file_list, *fd_ptr);
+	struct file_info_block*fib = find_fib(*fd_ptr);
 	if(fib==NULL){
 		/*if cur did not hold this file, return with false*/
 		return;
@@ -454,24 +744,35 @@ static void sys_close_handler(struct intr_frame *f){
 /*close the file given by file_info_block*/
 void close_file_by_fib(struct file_info_block *fib) {
 	ASSERT(fib != NULL);
-	ASSERT(!lock_held_by_current_thread (&global_file_list_lock));
-	lock_acquire(&global_file_list_lock);
-	struct global_file_block *gfb = find_opened_file(&global_file_list,
-			fib->f->inode->sector);
+	release_opened_file(fib->f, fib->file_name);
+
+	/*release the fd slot in current thread and free the fib*/
+	free_fd(thread_current(), fib->fd);
+	free(fib->file_name);
+	free(fib);
+}
+
+/*drop this opener's reference to FILE in the global file table and
+ * close it. the last opener of a file removed meanwhile removes it,
+ * by the FILE_NAME it was opened with*/
+static void release_opened_file(struct file *file, const char *file_name) {
+	struct gfb_bucket *bucket = gfb_bucket_of(file->inode->sector);
+	lock_acquire(&bucket->lock);
+	struct global_file_block *gfb = find_opened_file(bucket,
+			file->inode->sector);
 	if (gfb != NULL) {
 		ASSERT (!lock_held_by_current_thread (&gfb->lock));
 		lock_acquire(&gfb->lock);
-		/*remove it from the global_file_list if it's the last opener*/
+		/*remove it from the global_file_table if it's the last opener*/
 		if (gfb->ref_num <= 1) {
 			list_remove(&gfb->elem);
 		}
 	}
-	lock_release(&global_file_list_lock);
+	lock_release(&bucket->lock);
 
-	/*if not find, return, since this file is not opened*/
+	/*if not find, this file is not in the global table*/
 	if (gfb == NULL) {
-		file_close(fib->f);
-		return;
+		file_close(file);
 	} else {
 		ASSERT (lock_held_by_current_thread (&gfb->lock));
 		/*check the reference number*/
@@ -486,7 +787,7 @@ void close_file_by_fib(struct file_info_block *fib) {
 			lock_release(&gfb->lock);
 
 			if(need_remove){
-				filesys_remove(fib->file_name);
+				filesys_remove(file_name);
 			}
 
 			/*free the memory*/
@@ -494,12 +795,7 @@ void close_file_by_fib(struct file_info_block *fib) {
 		}
 
 		/*close the file*/
-		file_close(fib->f);
-		/*delete the file_info_block from opened_file_list in current
-		 * thread*/
-		list_remove(&fib->elem);
-		free(fib->file_name);
-		free(fib);
+		file_close(file);
 	}
 }
 
@@ -513,35 +809,38 @@ static void sys_open_handler(struct intr_frame *f){
 		 return;
 	}
 
-	/*get the full_line command*/
-	char *file_name=*(char **)(esp+1);
-
-	/*verify string address*/
-	if(!is_string_address_valid(file_name)){
-		user_exit(-1);
+	/*copy in the file name*/
+	char *file_name = copy_in_string(*(char **)(esp+1));
+	if (file_name == NULL) {
+		f->eax = -1;
 		return;
 	}
 
+	f->eax = open_file(file_name);
+	palloc_free_page(file_name);
+}
 
+/*open FILE_NAME, a kernel copy of the path, under a new fd of the
+ * current thread. return the fd, or -1 if it can not be opened*/
+static int open_file(const char *file_name){
 	/* get the actual file_name to open, need to store it in fib */
-	if (file_name == NULL || strlen(file_name) == 0) {
-		f->eax = -1;
-		return;
+	if (strlen(file_name) == 0) {
+		return -1;
 	}
 	char *name_to_open = malloc(NAME_MAX + 1);
 	if (name_to_open == NULL) {
-		f->eax = -1;
-		return;
+		return -1;
 	}
 
 	struct dir *dir = NULL;
 
-	dir = path_to_dir(file_name,name_to_open);
+	dir = path_to_dir((char *) file_name,name_to_open);
 
 	if(dir==NULL){
-	  f->eax = -1;
-			return;
+	  free(name_to_open);
+	  return -1;
 	}
+	dir_close(dir);
 	if(strlen(name_to_open)==0){
 	  /* set name_to_open to "/" */
 		  name_to_open[0] = '/';
@@ -551,37 +850,49 @@ static void sys_open_handler(struct intr_frame *f){
 	struct file *file = filesys_open(file_name);
 	/*return -1 if failed to open the file*/
 	if (file == NULL) {
-		f->eax = -1;
-		return;
+		free(name_to_open);
+		return -1;
 	}
 
+	return install_opened_file(file, name_to_open);
+}
+
+/*register an opened FILE, whose base name NAME_TO_OPEN is malloc'd and
+ * taken over, in global_file_table and in current thread's
+ * fd_table. return the new fd, or -1 with FILE closed*/
+int install_opened_file(struct file *file, char *name_to_open){
 	/*update global_file_block*/
-	ASSERT(!lock_held_by_current_thread (&global_file_list_lock));
-	lock_acquire(&global_file_list_lock);
-	struct global_file_block *gfb = find_opened_file(&global_file_list,
+	struct gfb_bucket *bucket = gfb_bucket_of(file->inode->sector);
+	lock_acquire(&bucket->lock);
+	struct global_file_block *gfb = find_opened_file(bucket,
 			file->inode->sector);
-	if (gfb != NULL) {
-		ASSERT (!lock_held_by_current_thread (&gfb->lock));
-		lock_acquire(&gfb->lock);
-	}
-	lock_release(&global_file_list_lock);
 
 	if (gfb == NULL) {
-		/*open a new file*/
+		/*open a new file, it is added before the bucket is unlocked
+		  so that a racing open of the same file finds it*/
 		gfb = malloc(sizeof(struct global_file_block));
+		if (gfb == NULL) {
+			lock_release(&bucket->lock);
+			file_close(file);
+			free(name_to_open);
+			return -1;
+		}
 		gfb->inode_block_num = file->inode->sector;
 		gfb->is_deleted = false;
 		gfb->ref_num = 1;
 		lock_init(&gfb->lock);
-		list_push_back(&global_file_list, &gfb->elem);
+		list_push_back(&bucket->list, &gfb->elem);
+		lock_release(&bucket->lock);
 	} else {
-		ASSERT (lock_held_by_current_thread (&gfb->lock));
+		ASSERT (!lock_held_by_current_thread (&gfb->lock));
+		lock_acquire(&gfb->lock);
+		lock_release(&bucket->lock);
 		/*the file is marked as deleted, fail the open*/
 		if (gfb->is_deleted) {
-			f->eax = -1;
 			lock_release(&gfb->lock);
 			file_close(file);
-			return;
+			free(name_to_open);
+			return -1;
 		}
 		/*increase file reference number*/
 		gfb->ref_num++;
@@ -589,38 +900,90 @@ static void sys_open_handler(struct intr_frame *f){
 	}
 
 
-	/*update current thread's opened_file_list*/
+	/*take the lowest free fd of current thread*/
 	struct thread *cur = thread_current();
 	struct file_info_block *fib = malloc(sizeof(struct file_info_block));
+	int fd = fib != NULL ? alloc_fd(cur) : -1;
+	if (fd < 0) {
+		free(fib);
+		fib = NULL;
+	}
 
 	if (fib == NULL) {
-		f->eax = -1;
-		/* rollback gfb and global_file_list if necessary */
-		lock_acquire(&global_file_list_lock);
-		ASSERT (gfb->ref_num >= 1);
-		if (gfb->ref_num == 1) {
-			/* newly opened file, remove the gfb */
-			list_remove(&gfb->elem);
-			free(gfb);
-		} else {
-			gfb->ref_num--;
-		}
-		lock_release(&global_file_list_lock);
-		free(fib);
-		file_close(file);
-		return;
+		/* rollback gfb and global_file_table as a close would, the
+		   file may have been removed meanwhile */
+		release_opened_file(file, name_to_open);
+		free(name_to_open);
+		return -1;
 	}
 
 	fib->f = file;
-	fib->fd = cur->next_fd_num++;
+	fib->fd = fd;
 
 	fib->file_name = name_to_open;
-	/*add file_info_block of the opened file into current thread's
-	  opened_file_list*/
-	list_push_back(&cur->opened_file_list, &fib->elem);
+	/*put file_info_block of the opened file into current thread's
+	  fd_table*/
+	cur->fd_table[fd] = fib;
 
+	return fib->fd;
+}
 
-	f->eax=fib->fd;
+/*give the current thread, a child forked by PARENT, a copy of each
+ * file PARENT has open, at the same fd and position. returns false
+ * if memory runs out, the files copied so far are closed on exit*/
+bool fork_fd_table(struct thread *parent){
+	struct thread *cur = thread_current();
+	if (parent->fd_table_size == 0) {
+		return true;
+	}
+	cur->fd_table = calloc(parent->fd_table_size,
+			sizeof(struct file_info_block *));
+	if (cur->fd_table == NULL) {
+		return false;
+	}
+	cur->fd_table_size = parent->fd_table_size;
+	cur->next_fd_num = parent->next_fd_num;
+
+	int fd;
+	for (fd = 0; fd < parent->fd_table_size; fd++) {
+		struct file_info_block *pfib = parent->fd_table[fd];
+		if (pfib == NULL) {
+			continue;
+		}
+		struct file_info_block *fib = malloc(sizeof(struct file_info_block));
+		if (fib == NULL) {
+			return false;
+		}
+		fib->f = file_reopen(pfib->f);
+		fib->file_name = malloc(strlen(pfib->file_name) + 1);
+		if (fib->f == NULL || fib->file_name == NULL) {
+			file_close(fib->f);
+			free(fib->file_name);
+			free(fib);
+			return false;
+		}
+		strlcpy(fib->file_name, pfib->file_name,
+				strlen(pfib->file_name) + 1);
+		file_seek(fib->f, file_tell(pfib->f));
+		fib->fd = fd;
+
+		/*the parent's open keeps the global_file_block alive, and a
+		  removed file stays usable by the child as by the parent*/
+		struct gfb_bucket *bucket = gfb_bucket_of(fib->f->inode->sector);
+		lock_acquire(&bucket->lock);
+		struct global_file_block *gfb = find_opened_file(bucket,
+				fib->f->inode->sector);
+		if (gfb != NULL) {
+			lock_acquire(&gfb->lock);
+			gfb->ref_num++;
+			lock_release(&gfb->lock);
+		}
+		lock_release(&bucket->lock);
+
+		cur->fd_table[fd] = fib;
+		cur->fd_count++;
+	}
+	return true;
 }
 
 /*handle sys_halt*/
@@ -677,17 +1040,16 @@ static void sys_create_handler(struct intr_frame *f){
 		 return;
 	}
 
-	char *file_name=*(char **)(esp+1);
-
-
 	int *file_size=(int *)(esp+2);
 
-	/* verify file_name string */
-	if(!is_string_address_valid(file_name)){
-		user_exit(-1);
+	/*copy in the file name*/
+	char *file_name = copy_in_string(*(char **)(esp+1));
+	if (file_name == NULL) {
+		f->eax = false;
 		return;
 	}
 	bool success = filesys_create(file_name, *file_size);
+	palloc_free_page(file_name);
 	/*return the value returned by filesys_create*/
 	f->eax=success;
 }
@@ -714,8 +1076,7 @@ static void sys_seek_handler(struct intr_frame *f){
 	int *pos_ptr=(int *)(esp+2);
 
 	/*find the file_info_block corresponding to the input fd*/
-	struct thread *cur=thread_current();
-	struct file_info_block *fib = find_fib(&cur->opened_file_list, *fd_ptr);
+	struct file_info_block *fib = find_fib(*fd_ptr);
 	if(fib==NULL){
 		return;
 	}
@@ -764,8 +1125,7 @@ static void sys_write_handler(struct intr_frame *f){
 	}
 
 	/*write to regular file*/
-	struct thread * cur=thread_current();
-	struct file_info_block*fib = find_fib(&cur->opened_file_list, *fd_ptr);
+	struct file_info_block*fib = find_fib(*fd_ptr);
 	if(fib==NULL){
 		/*if cur didnot hold this file, exit*/
 		user_exit(-1);
@@ -816,16 +1176,12 @@ static void sys_read_handler(struct intr_frame *f){
 
 	/*handle if fd==0, which is read from console*/
 	if(*fd_ptr==0){
-		int already_read = 0;
-		while(already_read < *size_ptr) {
-			buffer[already_read++] = input_getc();
-		}
-		/*handle return value*/
-		f->eax = *size_ptr;
+		bool line_end;
+		f->eax = read_from_console(buffer, *size_ptr, &line_end);
 	} else {
 	/*read from regular file*/
 		struct file_info_block *fib =
-				find_fib(&thread_current()->opened_file_list, *fd_ptr);
+				find_fib(*fd_ptr);
 		if (fib == NULL) {
 			f->eax = -1;
 		} else {
@@ -834,6 +1190,420 @@ static void sys_read_handler(struct intr_frame *f){
 	}
 }
 
+/*handle sys_pread*/
+static void sys_pread_handler(struct intr_frame *f){
+	uint32_t* esp=f->esp;
+	/*validate the 4 arguments at once*/
+	if(!is_user_address(esp+1, 4 * sizeof(int))){
+		 /* exit with -1*/
+		 user_exit(-1);
+		 return;
+	}
+
+	int *fd_ptr=(int *)(esp+1);
+	char *buffer=*(char **)(esp+2);
+	int *size_ptr=(int *)(esp+3);
+	int *pos_ptr=(int *)(esp+4);
+
+	/*verify whole buffer*/
+	if(!is_user_address((void *)buffer, *size_ptr)){
+		 user_exit(-1);
+		 return;
+	}
+
+	/*only regular files have a position to read at*/
+	struct file_info_block *fib =
+			find_fib(*fd_ptr);
+	if (fib == NULL || *pos_ptr < 0 || fib->f->inode->is_dir) {
+		f->eax = -1;
+		return;
+	}
+	/*file->pos is left untouched*/
+	pin_user_buffer(buffer, *size_ptr, true);
+	f->eax = file_read_at(fib->f, buffer, *size_ptr, *pos_ptr);
+	unpin_user_buffer(buffer, *size_ptr);
+}
+
+/*handle sys_pwrite*/
+static void sys_pwrite_handler(struct intr_frame *f){
+	uint32_t* esp=f->esp;
+	/*validate the 4 arguments at once*/
+	if(!is_user_address(esp+1, 4 * sizeof(int))){
+		 /* exit with -1*/
+		 user_exit(-1);
+		 return;
+	}
+
+	int *fd_ptr=(int *)(esp+1);
+	char *buffer=*(char **)(esp+2);
+	int *size_ptr=(int *)(esp+3);
+	int *pos_ptr=(int *)(esp+4);
+
+	/*verify whole buffer*/
+	if(!is_user_address((void *)buffer, *size_ptr)){
+		 user_exit(-1);
+		 return;
+	}
+
+	/*only regular files have a position to write at*/
+	struct file_info_block *fib =
+			find_fib(*fd_ptr);
+	if (fib == NULL || *pos_ptr < 0 || fib->f->inode->is_dir) {
+		f->eax = -1;
+		return;
+	}
+	/*file->pos is left untouched*/
+	pin_user_buffer(buffer, *size_ptr, false);
+	f->eax = file_write_at(fib->f, buffer, *size_ptr, *pos_ptr);
+	unpin_user_buffer(buffer, *size_ptr);
+}
+
+/*handle sys_readv*/
+static void sys_readv_handler(struct intr_frame *f){
+	uint32_t* esp=f->esp;
+	/*validate the 3 arguments at once*/
+	if(!is_user_address(esp+1, 3 * sizeof(int))){
+		 /* exit with -1*/
+		 user_exit(-1);
+		 return;
+	}
+
+	int *fd_ptr=(int *)(esp+1);
+	struct iovec *iov=*(struct iovec **)(esp+2);
+	int *cnt_ptr=(int *)(esp+3);
+
+	if (*cnt_ptr < 0 || *cnt_ptr > IOV_MAX) {
+		f->eax = -1;
+		return;
+	}
+	/*verify the iovec array and every buffer in it*/
+	bool too_long;
+	if(!is_iovec_valid(iov, *cnt_ptr, &too_long)){
+		 user_exit(-1);
+		 return;
+	}
+	if (too_long) {
+		f->eax = -1;
+		return;
+	}
+
+	int i;
+	int total = 0;
+	/*handle if fd==0, which is read from console*/
+	if(*fd_ptr==0){
+		bool line_end = false;
+		for (i = 0; i < *cnt_ptr && !line_end; i++) {
+			int n = read_from_console(iov[i].iov_base, iov[i].iov_len,
+					&line_end);
+			if (n < 0) {
+				f->eax = -1;
+				return;
+			}
+			total += n;
+		}
+		f->eax = total;
+		return;
+	}
+
+	struct file_info_block *fib =
+			find_fib(*fd_ptr);
+	if (fib == NULL || fib->f->inode->is_dir) {
+		f->eax = -1;
+		return;
+	}
+
+	/*pin every buffer up front, reads do not take the inode lock*/
+	pin_iovec(iov, *cnt_ptr, true);
+	for (i = 0; i < *cnt_ptr; i++) {
+		int n = file_read(fib->f, iov[i].iov_base, iov[i].iov_len);
+		total += n;
+		if (n < (int) iov[i].iov_len) {
+			break;
+		}
+	}
+	unpin_iovec(iov, *cnt_ptr);
+	f->eax = total;
+}
+
+/*handle sys_writev*/
+static void sys_writev_handler(struct intr_frame *f){
+	uint32_t* esp=f->esp;
+	/*validate the 3 arguments at once*/
+	if(!is_user_address(esp+1, 3 * sizeof(int))){
+		 /* exit with -1*/
+		 user_exit(-1);
+		 return;
+	}
+
+	int *fd_ptr=(int *)(esp+1);
+	struct iovec *iov=*(struct iovec **)(esp+2);
+	int *cnt_ptr=(int *)(esp+3);
+
+	if (*cnt_ptr < 0 || *cnt_ptr > IOV_MAX) {
+		f->eax = -1;
+		return;
+	}
+	/*verify the iovec array and every buffer in it*/
+	bool too_long;
+	if(!is_iovec_valid(iov, *cnt_ptr, &too_long)){
+		 user_exit(-1);
+		 return;
+	}
+	if (too_long) {
+		f->eax = -1;
+		return;
+	}
+
+	int i;
+	int total = 0;
+	/*handle if fd==1, gather into a page and write to console with as
+	 * few putbuf calls as possible*/
+	if(*fd_ptr==1){
+		char *page = palloc_get_page(0);
+		if (page == NULL) {
+			f->eax = -1;
+			return;
+		}
+		size_t used = 0;
+		for (i = 0; i < *cnt_ptr; i++) {
+			const char *buffer = iov[i].iov_base;
+			size_t left = iov[i].iov_len;
+			while (left > 0) {
+				size_t chunk = left < PGSIZE - used ? left : PGSIZE - used;
+				memcpy(page + used, buffer, chunk);
+				used += chunk;
+				buffer += chunk;
+				left -= chunk;
+				if (used == PGSIZE) {
+					putbuf(page, used);
+					used = 0;
+				}
+			}
+			total += iov[i].iov_len;
+		}
+		if (used > 0) {
+			putbuf(page, used);
+		}
+		palloc_free_page(page);
+		f->eax = total;
+		return;
+	}
+
+	struct file_info_block *fib =
+			find_fib(*fd_ptr);
+	if(fib==NULL){
+		/*if cur didnot hold this file, exit*/
+		user_exit(-1);
+		return;
+	}
+	/* if fd is corresponding to a dir, fail the write */
+	if (fib->f->inode->is_dir) {
+		f->eax = -1;
+		return;
+	}
+
+	/*pin every buffer before taking the inode lock, so no page is
+	 * brought in with it held. then hold it once for all the writes,
+	 * inode_write_at reuses it*/
+	struct inode *inode = fib->f->inode;
+	struct iovec kiov[IOV_MAX];   /*the array itself may fault*/
+	int cnt = *cnt_ptr;
+	memcpy(kiov, iov, cnt * sizeof *iov);
+	pin_iovec(kiov, cnt, false);
+	lock_acquire(&inode->inode_lock);
+	for (i = 0; i < cnt; i++) {
+		int n = file_write(fib->f, kiov[i].iov_base, kiov[i].iov_len);
+		total += n;
+		if (n < (int) kiov[i].iov_len) {
+			break;
+		}
+	}
+	lock_release(&inode->inode_lock);
+	unpin_iovec(kiov, cnt);
+	f->eax = total;
+}
+
+/*handle sys_copy_file_range*/
+static void sys_copy_file_range_handler(struct intr_frame *f){
+	uint32_t* esp=f->esp;
+	/*validate the 3 arguments at once*/
+	if(!is_user_address(esp+1, 3 * sizeof(int))){
+		 /* exit with -1*/
+		 user_exit(-1);
+		 return;
+	}
+
+	int *in_fd_ptr=(int *)(esp+1);
+	int *out_fd_ptr=(int *)(esp+2);
+	int *size_ptr=(int *)(esp+3);
+
+	struct file_info_block *in_fib =
+			find_fib(*in_fd_ptr);
+	struct file_info_block *out_fib =
+			find_fib(*out_fd_ptr);
+	/*both ends must be regular files, and not the same one*/
+	if (in_fib == NULL || out_fib == NULL || *size_ptr < 0
+			|| in_fib->f->inode->is_dir || out_fib->f->inode->is_dir
+			|| in_fib->f->inode == out_fib->f->inode) {
+		f->eax = -1;
+		return;
+	}
+
+	/*copy from and advance both files' positions*/
+	struct file *in = in_fib->f;
+	struct file *out = out_fib->f;
+	off_t copied = inode_copy_at(out->inode, out->pos, in->inode, in->pos,
+			*size_ptr);
+	in->pos += copied;
+	out->pos += copied;
+	f->eax = copied;
+}
+
+/*handle sys_io_setup*/
+static void sys_io_setup_handler(struct intr_frame *f){
+	uint32_t* esp=f->esp;
+	/*validate the 1st argument*/
+	if(!is_user_address(esp+1, sizeof(void *))){
+		 /* exit with -1*/
+		 user_exit(-1);
+		 return;
+	}
+
+	struct io_ring *ring=*(struct io_ring **)(esp+1);
+	/*verify the whole ring*/
+	if(!is_user_address(ring, sizeof(struct io_ring))){
+		 user_exit(-1);
+		 return;
+	}
+	f->eax = aio_setup(ring);
+}
+
+/*handle sys_io_enter*/
+static void sys_io_enter_handler(struct intr_frame *f){
+	uint32_t* esp=f->esp;
+	/*validate the 2 arguments at once*/
+	if(!is_user_address(esp+1, 2 * sizeof(int))){
+		 /* exit with -1*/
+		 user_exit(-1);
+		 return;
+	}
+
+	unsigned *to_submit_ptr=(unsigned *)(esp+1);
+	unsigned *min_complete_ptr=(unsigned *)(esp+2);
+	f->eax = aio_enter(*to_submit_ptr, *min_complete_ptr);
+}
+
+/*handle sys_batch*/
+static void sys_batch_handler(struct intr_frame *f){
+	uint32_t* esp=f->esp;
+	/*validate the 3 arguments at once*/
+	if(!is_user_address(esp+1, 3 * sizeof(int))){
+		 /* exit with -1*/
+		 user_exit(-1);
+		 return;
+	}
+
+	struct syscall_rec *recs=*(struct syscall_rec **)(esp+1);
+	unsigned *count_ptr=(unsigned *)(esp+2);
+	bool stop_on_error=*(int *)(esp+3) != 0;
+
+	if (*count_ptr > BATCH_MAX) {
+		f->eax = -1;
+		return;
+	}
+	/*verify the whole array once, each handler still checks its own
+	  pointer arguments*/
+	if(*count_ptr > 0 &&
+			!is_user_address(recs, *count_ptr * sizeof(struct syscall_rec))){
+		 user_exit(-1);
+		 return;
+	}
+
+	/*run each record through the normal dispatch, with the record
+	  standing in for the user stack*/
+	struct intr_frame rec_frame = *f;
+	unsigned i;
+	for (i = 0; i < *count_ptr; i++) {
+		if (recs[i].number == SYS_BATCH || recs[i].number == SYS_FORK) {
+			/*no nesting, and the child of a fork would return to the
+			  record instead of the user stack*/
+			recs[i].result = -1;
+		} else {
+			rec_frame.esp = &recs[i];
+			rec_frame.eax = -1;
+			syscall_handler(&rec_frame);
+			/*seek and close return nothing, report success*/
+			recs[i].result = recs[i].number == SYS_SEEK
+					|| recs[i].number == SYS_CLOSE ? 0 : (int) rec_frame.eax;
+		}
+		if (stop_on_error && batch_failed(recs[i].number, recs[i].result)) {
+			i++;
+			break;
+		}
+	}
+	/*the number of records run*/
+	f->eax = i;
+}
+
+/*whether a call NUMBER returning RESULT failed. the calls returning
+ * bool fail with false, the others with a negative value. seek and
+ * close return nothing and wait returns the child's exit status, so
+ * they never fail*/
+static bool batch_failed(int number, int result){
+	switch (number) {
+	case SYS_SEEK:
+	case SYS_CLOSE:
+	case SYS_WAIT:
+		return false;
+	case SYS_CREATE:
+	case SYS_REMOVE:
+	case SYS_CHDIR:
+	case SYS_MKDIR:
+	case SYS_READDIR:
+		return result == 0;
+	default:
+		return result < 0;
+	}
+}
+
+/*handle sys_fork*/
+static void sys_fork_handler(struct intr_frame *f){
+	/*the child returns from the same frame with 0*/
+	tid_t tid = process_fork(f);
+	f->eax = tid == TID_ERROR ? -1 : tid;
+}
+
+/*validate an iovec array of IOVCNT buffers in one pass. returns
+ * false if an address is bad. *TOO_LONG is set, and the buffers left
+ * unchecked, if the total length does not fit in the int return
+ * value, which is an invalid argument rather than a fault*/
+static bool is_iovec_valid(const struct iovec *iov, int iovcnt,
+		bool *too_long){
+	*too_long = false;
+	if (iovcnt == 0) {
+		return true;
+	}
+	if (!is_user_address(iov, iovcnt * sizeof(struct iovec))) {
+		return false;
+	}
+	int i;
+	unsigned total = 0;
+	for (i = 0; i < iovcnt; i++) {
+		if (iov[i].iov_len > INT32_MAX - total) {
+			*too_long = true;
+			return true;
+		}
+		total += iov[i].iov_len;
+	}
+	for (i = 0; i < iovcnt; i++) {
+		if (iov[i].iov_len > 0 &&
+				!is_user_address(iov[i].iov_base, iov[i].iov_len)) {
+			return false;
+		}
+	}
+	return true;
+}
+
 /*user process exit with exit_code*/
 void user_exit(int exit_code){
 	struct thread* cur=thread_current();
@@ -842,7 +1612,7 @@ void user_exit(int exit_code){
 }
 
 /*judge if the pointer points to a valid space*/
-static bool is_user_address(const void *pointer, int size){
+bool is_user_address(const void *pointer, int size){
 	uint32_t address=(uint32_t)pointer;
 	void *end_pointer=(void *)(address+size-1);
 	int page_range=(address+size-1)/PGSIZE-address/PGSIZE;
@@ -871,37 +1641,27 @@ static bool is_user_address(const void *pointer, int size){
 }
 
 
-/*judge if the a string's address is valid*/
-static bool is_string_address_valid(const void *pointer){
-	uint8_t *str=(uint8_t *)pointer;
-	int byte_value;
+/*judge if the a string's address is valid. each page of the
+ * string is probed once, then scanned in place for the null*/
+bool is_string_address_valid(const void *pointer){
+	const char *str = pointer;
 	/*check if pointer is null*/
 	if(str==NULL){
 		return false;
 	}
 
-	/*1 by 1 check each char's address*/
-	while(true){
-		/*if over the user's space return*/
-		if(!is_user_vaddr(str)){
-			return false;
-		}
-
-		/*if unmmaped return*/
-		byte_value= get_user(str);
-		if(byte_value==-1){
+	/*PHYS_BASE is page aligned, so a page never straddles it*/
+	while(is_user_vaddr(str)){
+		if(get_user((const uint8_t *)str)==-1){
 			return false;
 		}
-
-		/*if reached the end of the string, return true*/
-		if(byte_value==0){
+		size_t page_left = PGSIZE - pg_ofs(str);
+		if(memchr(str, '\0', page_left)!=NULL){
 			return true;
 		}
-		str++;
+		str += page_left;
 	}
-
-	/*dummy return, never called*/
-	return true;
+	return false;
 }
 
 /*check if page mapped*/
@@ -912,6 +1672,91 @@ static bool is_page_mapped (const void *uaddr_){
 }
 
 
+/*copy SIZE bytes from user address USRC to kernel DST, in one pass
+ * with no separate validation. return false if any of USRC is
+ * unmapped or not a user address*/
+bool copy_from_user(void *dst, const void *usrc, size_t size){
+	if (!is_user_range(usrc, size)) {
+		return false;
+	}
+	return copy_user(dst, usrc, size) == 0;
+}
+
+/*copy SIZE bytes from kernel SRC to user address UDST. return false
+ * if any of UDST is unmapped, read-only or not a user address*/
+bool copy_to_user(void *udst, const void *src, size_t size){
+	if (!is_user_range(udst, size)) {
+		return false;
+	}
+	return copy_user(udst, src, size) == 0;
+}
+
+/*copy the null-terminated user string USRC into kernel DST of SIZE
+ * bytes, a page at a time. return the string length, -1 if USRC
+ * faults, or SIZE if it does not fit in DST*/
+int strncpy_from_user(char *dst, const char *usrc, size_t size){
+	size_t copied = 0;
+	while (copied < size) {
+		/*a chunk never crosses into a page past the null*/
+		size_t chunk = PGSIZE - pg_ofs(usrc + copied);
+		if (chunk > size - copied) {
+			chunk = size - copied;
+		}
+		if (!is_user_range(usrc + copied, chunk)
+				|| copy_user(dst + copied, usrc + copied, chunk) != 0) {
+			return -1;
+		}
+		char *nul = memchr(dst + copied, '\0', chunk);
+		if (nul != NULL) {
+			return nul - dst;
+		}
+		copied += chunk;
+	}
+	return size;
+}
+
+/*copy the user string USTR into a new page, which the caller frees
+ * with palloc_free_page. exits if USTR faults. return NULL if the
+ * string does not fit in a page or no page is left*/
+static char *copy_in_string(const char *ustr){
+	char *kstr = palloc_get_page(0);
+	if (kstr == NULL) {
+		return NULL;
+	}
+	int len = strncpy_from_user(kstr, ustr, PGSIZE);
+	if (len < 0) {
+		palloc_free_page(kstr);
+		user_exit(-1);
+		return NULL;
+	}
+	if (len == PGSIZE) {
+		palloc_free_page(kstr);
+		return NULL;
+	}
+	return kstr;
+}
+
+/*judge if [UADDR, UADDR+SIZE) lies in user space, without touching it*/
+static bool is_user_range(const void *uaddr, size_t size){
+	uintptr_t start = (uintptr_t) uaddr;
+	return uaddr != NULL && start + size >= start
+			&& start + size <= (uintptr_t) PHYS_BASE;
+}
+
+/* Copies SIZE bytes from SRC to DST, one of which is user memory
+   already known to lie below PHYS_BASE.  A fault stops the copy
+   and resumes at label 1 through page_fault(), like get_user().
+   Returns the number of bytes not copied. */
+static size_t
+copy_user (void *dst, const void *src, size_t size)
+{
+  int fixup;
+  asm volatile ("movl $1f, %0; rep movsb; 1:"
+                : "=&a" (fixup), "+D" (dst), "+S" (src), "+c" (size)
+                : : "memory");
+  return size;
+}
+
 /* Reads a byte at user virtual address UADDR.
    UADDR must be below PHYS_BASE.
    Returns the byte value if successful, -1 if a segfault
@@ -925,12 +1770,20 @@ get_user (const uint8_t *uaddr)
   return result;
 }
 
-/*search global file list for the given block_sector_t*/
+/*get the bucket of global_file_table for the given block_sector_t*/
+static struct gfb_bucket *gfb_bucket_of(block_sector_t s) {
+	return &global_file_table[hash_int((int) s) % GFB_BUCKETS];
+}
+
+/*search a bucket of global_file_table for the given block_sector_t,
+ * must hold the bucket's lock*/
 static struct global_file_block *find_opened_file(
-		struct list* l, block_sector_t s) {
+		struct gfb_bucket *bucket, block_sector_t s) {
 	struct global_file_block *gf = NULL;
 	struct list_elem *e = NULL;
+	struct list *l = &bucket->list;
 
+	ASSERT (lock_held_by_current_thread (&bucket->lock));
 	for (e = list_begin (l); e != list_end (l); e = list_next (e)) {
 		gf = list_entry (e, struct global_file_block, elem);
 		if (gf->inode_block_num == s) {
@@ -941,19 +1794,55 @@ static struct global_file_block *find_opened_file(
 	return NULL;
 }
 
-/*in opened_file_list, search for file_info_block using fd*/
-static struct file_info_block* find_fib(struct list* l, int fd) {
-	struct file_info_block *fib = NULL;
-	struct list_elem *e = NULL;
+/*in current thread's fd_table, get the file_info_block of fd*/
+struct file_info_block* find_fib(int fd) {
+	struct thread *cur = thread_current();
+	if (fd < 0 || fd >= cur->fd_table_size) {
+		return NULL;
+	}
+	return cur->fd_table[fd];
+}
 
-	for (e = list_begin (l); e != list_end (l); e = list_next (e)) {
-		fib = list_entry (e, struct file_info_block, elem);
-		if (fib->fd == fd) {
-			return fib;
+/*reserve the lowest free fd of thread T, growing its fd_table if
+ * it is full. the slot stays NULL until the caller fills it.
+ * return -1 if the table can not grow*/
+static int alloc_fd(struct thread *t) {
+	int fd;
+	/*no slot below next_fd_num is free*/
+	for (fd = t->next_fd_num; fd < t->fd_table_size; fd++) {
+		if (t->fd_table[fd] == NULL) {
+			break;
 		}
 	}
 
-	return NULL;
+	if (fd == t->fd_table_size) {
+		int new_size = t->fd_table_size == 0 ?
+				FD_TABLE_INIT_SIZE : t->fd_table_size * 2;
+		struct file_info_block **new_table = realloc(t->fd_table,
+				new_size * sizeof(struct file_info_block *));
+		if (new_table == NULL) {
+			return -1;
+		}
+		memset(new_table + t->fd_table_size, 0,
+				(new_size - t->fd_table_size) *
+				sizeof(struct file_info_block *));
+		t->fd_table = new_table;
+		t->fd_table_size = new_size;
+	}
+
+	t->fd_count++;
+	t->next_fd_num = fd + 1;
+	return fd;
+}
+
+/*release fd of thread T so that it can be reused*/
+static void free_fd(struct thread *t, int fd) {
+	ASSERT (fd >= 2 && fd < t->fd_table_size);
+	t->fd_table[fd] = NULL;
+	t->fd_count--;
+	if (fd < t->next_fd_num) {
+		t->next_fd_num = fd;
+	}
 }
 
 /*handle sys_filesize*/
@@ -969,8 +1858,7 @@ static void sys_filesize_handler(struct intr_frame *f){
 	/*get the full_line command*/
 	int *fd_ptr=(int *)(esp+1);
 
-	struct thread * cur=thread_current();
-	struct file_info_block*fib = find_fib(&cur->opened_file_list, *fd_ptr);
+	struct file_info_block*fib = find_fib(*fd_ptr);
 	if(fib==NULL){
 		/*if cur did not hold this file, return with -1*/
 		f->eax=-1;
@@ -995,8 +1883,7 @@ static void sys_tell_handler(struct intr_frame *f){
 	/*get the full_line command*/
 	int *fd_ptr=(int *)(esp+1);
 
-	struct thread * cur=thread_current();
-	struct file_info_block*fib = find_fib(&cur->opened_file_list, *fd_ptr);
+	struct file_info_block*fib = find_fib(*fd_ptr);
 	if(fib==NULL){
 		/*if cur did not hold this file, return with -1*/
 		f->eax=-1;
@@ -1010,12 +1897,80 @@ static void sys_tell_handler(struct intr_frame *f){
 
 /*read from file with buffer of size*/
 static int read_from_file(struct file* f, void *buffer, int size) {
-	return file_read(f, buffer, size);
+	pin_user_buffer(buffer, size, true);
+	int result = file_read(f, buffer, size);
+	unpin_user_buffer(buffer, size);
+	return result;
+}
+
+/*keep the user BUFFER of SIZE in memory while the file system copies
+ * to or from it, since a page fault there would come back into the
+ * file system with its locks held. a buffer to WRITE is unshared
+ * from a fork up front for the same reason. exits if it can not be
+ * loaded*/
+static void pin_user_buffer(const void *buffer UNUSED, size_t size UNUSED,
+		bool write UNUSED) {
+#ifdef VM
+	if (!page_pin_range(buffer, size, write)) {
+		user_exit(-1);
+	}
+#endif
+}
+
+/*release a buffer pinned by pin_user_buffer*/
+static void unpin_user_buffer(const void *buffer UNUSED,
+		size_t size UNUSED) {
+#ifdef VM
+	page_unpin_range(buffer, size);
+#endif
+}
+
+/*pin the CNT buffers of IOV, already validated, as pin_user_buffer
+ * does. exits if one can not be loaded*/
+static void pin_iovec(const struct iovec *iov, int cnt, bool write) {
+	int i;
+	for (i = 0; i < cnt; i++) {
+		pin_user_buffer(iov[i].iov_base, iov[i].iov_len, write);
+	}
+}
+
+/*release the buffers pinned by pin_iovec*/
+static void unpin_iovec(const struct iovec *iov, int cnt) {
+	int i;
+	for (i = 0; i < cnt; i++) {
+		unpin_user_buffer(iov[i].iov_base, iov[i].iov_len);
+	}
+}
+
+/*read console input into user UBUF of SIZE, stopping early when a
+ * line ends, which sets *LINE_END. keys are taken in bulk through a
+ * small kernel buffer, so the user pages are never touched with
+ * interrupts off. returns the bytes read, or -1 if UBUF faults*/
+static int read_from_console(char *ubuf, int size, bool *line_end) {
+	uint8_t kbuf[INTQ_BUFSIZE];
+	int total = 0;
+	*line_end = false;
+	while (total < size && !*line_end) {
+		size_t want = size - total;
+		if (want > sizeof kbuf) {
+			want = sizeof kbuf;
+		}
+		size_t n = input_read(kbuf, want, false);
+		if (!copy_to_user(ubuf + total, kbuf, n)) {
+			return -1;
+		}
+		total += n;
+		*line_end = input_is_eol(kbuf[n - 1]);
+	}
+	return total;
 }
 
 /*write to file with buffer of size*/
 static int write_to_file(struct file *file, char *buffer, size_t size){
-	return file_write (file, buffer, size);
+	pin_user_buffer(buffer, size, false);
+	int result = file_write (file, buffer, size);
+	unpin_user_buffer(buffer, size);
+	return result;
 }
 
 
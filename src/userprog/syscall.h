@@ -2,22 +2,50 @@
 #define USERPROG_SYSCALL_H
 
 #include <list.h>
+#include <stdint.h>
+#include <syscall-nr.h>
 #include "filesys/file.h"
 #include "threads/synch.h"
-
-struct lock global_file_list_lock; /*lock just for global_file_list, not for the entire filesys*/
+#include "threads/thread.h"
 
 /*store opened files info*/
 struct file_info_block {
 	struct file *f;                /*file structure for the opened file*/
 	char *file_name;               /*file_name for the opened file*/
-	int fd;                        /*file descriptor for the opened file*/
-	struct list_elem elem;         /*list elem for thread's
-	opened_file_list*/
+	int fd;                        /*file descriptor for the opened file,
+	                                 its index in thread's fd_table*/
 };
 
+/*number of latency histogram buckets, bucket i counts calls of
+  2^(i + SYSCALL_HIST_SHIFT) to 2^(i + SYSCALL_HIST_SHIFT + 1) cycles,
+  the first and last also take everything below and above*/
+#define SYSCALL_HIST_BUCKETS 16
+#define SYSCALL_HIST_SHIFT 7
+
+/*per system call number counts and latencies*/
+struct syscall_stats {
+	uint32_t count[SYS_CNT];       /*calls made*/
+	uint64_t cycles[SYS_CNT];      /*TSC cycles spent in finished calls*/
+	uint32_t hist[SYS_CNT][SYSCALL_HIST_BUCKETS]; /*latency histogram*/
+};
+
+/*-sc-stats: print each process's syscall stats when it exits and
+ * the system-wide ones at shutdown*/
+extern bool syscall_stats_enabled;
+
 void syscall_init (void);
+void syscall_print_stats (void);
+void syscall_print_process_stats (const char *name,
+		const struct syscall_stats *stats);
 void user_exit(int exit_code);
 void close_file_by_fib(struct file_info_block *fib);
+int install_opened_file(struct file *file, char *name_to_open);
+bool fork_fd_table(struct thread *parent);
+struct file_info_block* find_fib(int fd);
+bool is_user_address(const void *pointer, int size);
+bool is_string_address_valid(const void *pointer);
+bool copy_from_user(void *dst, const void *usrc, size_t size);
+bool copy_to_user(void *udst, const void *src, size_t size);
+int strncpy_from_user(char *dst, const char *usrc, size_t size);
 
 #endif /* userprog/syscall.h */
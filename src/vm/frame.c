@@ -4,193 +4,644 @@
 #include "threads/malloc.h"
 #include "threads/vaddr.h"
 #include "vm/swap.h"
-#include "userprog/syscall.h"
+#include "filesys/file.h"
+#include "userprog/pagedir.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
 #include <list.h>
+#include <string.h>
 
-/* List of all frame_table_entry. */
-static struct list frame_table;
-/*lock for frame_table*/
+/* Array of frame_table_entry, one for each page of the user pool,
+ * indexed by (frame_addr - frame_base) / PGSIZE. */
+static struct frame_table_entry *frame_table;
+static uint8_t *frame_base;      /*first page of the user pool*/
+static size_t frame_cnt;         /*number of entries in frame_table*/
+/*lock for frame_table, the text_table and every fte's spte_list*/
 static struct lock frame_table_lock;
-struct list_elem *clock_hand;  /*current frame_table_entry the clock
-                                algorithm is pointing to*/
+static size_t clock_hand;        /*index of the frame_table_entry the
+                                   clock algorithm is pointing to, its
+                                   back hand*/
+static size_t hand_spread;       /*frames the front hand, which clears
+                                   accessed bits, runs ahead of it*/
+static struct hash text_table;   /*shared read-only text frames, by
+                                   (text_inode, text_offset,
+                                   text_read_bytes)*/
+static struct condition text_loaded;  /*signaled when a text frame is
+                                        read in, with frame_table_lock*/
+static void *zero_page;          /*page of zeros mapped read-only by
+                                   every untouched bss and stack page,
+                                   it is not in the frame_table*/
+static size_t used_cnt;          /*frames in use, the rest are free in
+                                   the user pool*/
+static size_t low_water;         /*the page-out daemon is woken when
+                                   fewer frames than this are free*/
+static size_t high_water;        /*and evicts until this many are free*/
+static struct condition pageout_needed;  /*signaled, with
+                                           frame_table_lock, when free
+                                           frames drop below low_water*/
 
+#define PAGEOUT_RETRY_TICKS 10   /*how long the page-out daemon waits
+                                   when it finds nothing to evict*/
 
-struct frame_table_entry *
-create_fte(struct thread* t,uint8_t *frame_addr,
-		struct supplemental_pte* spte);
-struct frame_table_entry *
-evict_frame(struct supplemental_pte *spte);
+
+static struct frame_table_entry *alloc_frame(void);
+static struct frame_table_entry *claim_frame(uint8_t *frame_addr);
+static struct frame_table_entry *evict_frame(void);
+static void free_frame(struct frame_table_entry *fte);
+static size_t free_frame_cnt(void);
+static void pageout_daemon(void *aux);
+static struct frame_table_entry *frame_of(const void *frame_addr);
+static bool frame_accessed(struct frame_table_entry *fte);
+static void frame_clear_accessed(struct frame_table_entry *fte);
+static void link_spte(struct frame_table_entry *fte,
+		struct supplemental_pte *spte);
+static bool lock_sptes(struct frame_table_entry *fte);
+static void unlock_sptes(struct frame_table_entry *fte,
+		struct list_elem *stop);
+static struct frame_table_entry *find_text(struct inode *inode,
+		off_t offset, size_t read_bytes);
+static unsigned text_hash_func(const struct hash_elem *e, void *aux);
+static bool text_less_func(const struct hash_elem *a,
+		const struct hash_elem *b, void *aux);
 
 
-/*init frame table*/
-void frame_table_init(){
-	  clock_hand = NULL;
+/*init frame table, with an entry for every user pool page*/
+void frame_table_init(void){
+	  size_t i;
+	  frame_base = palloc_user_base ();
+	  frame_cnt = palloc_user_page_cnt ();
+	  frame_table = calloc (frame_cnt, sizeof (struct frame_table_entry));
+	  if (frame_table == NULL) {
+		  PANIC ("fail to allocate frame table");
+	  }
+	  for (i = 0; i < frame_cnt; i++) {
+		  frame_table[i].frame_addr = frame_base + i * PGSIZE;
+		  list_init (&frame_table[i].spte_list);
+	  }
+	  clock_hand = 0;
+	  hand_spread = frame_cnt / 4;
+	  used_cnt = 0;
+	  low_water = frame_cnt / 32 + 2;
+	  high_water = frame_cnt / 16 + 4;
 	  lock_init (&frame_table_lock);
-	  list_init (&frame_table);
+	  cond_init (&text_loaded);
+	  cond_init (&pageout_needed);
+	  if (!hash_init (&text_table, text_hash_func, text_less_func, NULL)) {
+		  PANIC ("fail to init text table");
+	  }
+	  zero_page = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+
+	  /*create the page-out daemon thread*/
+	  tid_t t = thread_create ("pageout_daemon", PRI_DEFAULT,
+			  pageout_daemon, NULL);
+	  if (t == TID_ERROR) {
+		  PANIC ("fail to create page-out daemon");
+	  }
+}
+
+/*the shared zero page, never written and never evicted*/
+void *frame_zero_page(void){
+	return zero_page;
 }
 
-/*get a frame, and generate a correspinding frame_table_entry*/
+/*get a frame, and generate a correspinding frame_table_entry.
+ * the frame is returned pinned, need to unpin outside*/
 struct frame_table_entry*
 get_frame (struct supplemental_pte *spte)
+{
+  struct frame_table_entry *fte = alloc_frame ();
+  if (fte != NULL)
+    {
+      lock_acquire (&frame_table_lock);
+      link_spte (fte, spte);
+      lock_release (&frame_table_lock);
+    }
+  return fte;
+}
+
+/*make SPTE, a page of a forked child, map FTE along with the pages
+ * already mapping it. the caller must hold the lock of an spte that
+ * maps FTE, so that it is not evicted meanwhile*/
+void
+frame_share (struct frame_table_entry *fte, struct supplemental_pte *spte)
+{
+  lock_acquire (&frame_table_lock);
+  link_spte (fte, spte);
+  lock_release (&frame_table_lock);
+}
+
+/*give SPTE, whose lock the caller holds, a frame of its own on a
+ * write to its copy-on-write page. the last owner of a shared frame
+ * just gets it back writable, the others copy it into a new frame.
+ * returns false if no frame is left for the copy*/
+bool
+frame_unshare (struct supplemental_pte *spte)
+{
+  ASSERT (lock_held_by_current_thread (&spte->lock));
+  ASSERT (spte->writable && spte->fte != NULL);
+  struct frame_table_entry *old = spte->fte;
+  uint32_t *pd = spte->t->pagedir;
+
+  /*a fork adds sharers under frame_table_lock*/
+  lock_acquire (&frame_table_lock);
+  if (old->ref_cnt == 1)
+    {
+      pagedir_set_writable (pd, spte->uaddr, true);
+      lock_release (&frame_table_lock);
+      return true;
+    }
+  lock_release (&frame_table_lock);
+
+  struct frame_table_entry *fte = alloc_frame ();
+  if (fte == NULL)
+    return false;
+  /*the sharers only read OLD, and our spte lock keeps it in memory*/
+  memcpy (fte->frame_addr, old->frame_addr, PGSIZE);
+  pagedir_clear_page (pd, spte->uaddr);
+  frame_release (old, spte);
+
+  lock_acquire (&frame_table_lock);
+  link_spte (fte, spte);
+  lock_release (&frame_table_lock);
+  /*the page table is still there, so this can not fail*/
+  pagedir_set_page (pd, spte->uaddr, fte->frame_addr, true);
+  frame_unpin (fte);
+  return true;
+}
+
+/*pin FTE, which the caller keeps from being freed, so that it is
+ * not evicted until it is unpinned as many times*/
+void
+frame_pin (struct frame_table_entry *fte)
+{
+  lock_acquire (&frame_table_lock);
+  fte->pin_cnt++;
+  lock_release (&frame_table_lock);
+}
+
+/*drop a pin of FTE*/
+void
+frame_unpin (struct frame_table_entry *fte)
+{
+  lock_acquire (&frame_table_lock);
+  ASSERT (fte->pin_cnt > 0);
+  fte->pin_cnt--;
+  lock_release (&frame_table_lock);
+}
+
+/*get a frame with no page mapping it yet, from the pool or by
+ * evicting one. the frame is returned pinned*/
+static struct frame_table_entry *
+alloc_frame (void)
 {
   /* get a physical address of a free frame*/
   uint8_t *frame_addr = palloc_get_page (PAL_USER);
 
   if (frame_addr != NULL)
-  {
-    /* create a frame_table_entry and return */
-    return create_fte (thread_current (), frame_addr, spte);
-  } else {
-    /* no available frame, need to evict one  */
-	  return evict_frame(spte);
-  }
+    return claim_frame (frame_addr);
+
+  /* no available frame, the daemon fell behind, need to evict one  */
+  lock_acquire (&frame_table_lock);
+  cond_signal (&pageout_needed, &frame_table_lock);
+  lock_release (&frame_table_lock);
+  return evict_frame ();
 }
 
-/*evict a frame and return its frame_table_entry pointer*/
+/*whether SPTE's text page is in a frame already, so mapping it does
+ * no disk I/O*/
+bool
+frame_has_text (const struct supplemental_pte *spte)
+{
+	struct frame_table_entry *fte;
+	lock_acquire(&frame_table_lock);
+	fte = find_text(file_get_inode(spte->f), spte->offset,
+			PGSIZE - spte->zero_bytes);
+	bool present = fte != NULL && !fte->loading;
+	lock_release(&frame_table_lock);
+	return present;
+}
+
+/*get the frame holding SPTE's read-only text page. a process that
+ * runs the same executable as one already running maps the frame
+ * that one loaded, only the first reads it from the file. returns
+ * the frame linked to SPTE, which must be locked by the caller, or
+ * NULL if it can not be loaded*/
 struct frame_table_entry *
-evict_frame(struct supplemental_pte *spte){
-	lock_acquire (&frame_table_lock);
-	struct list_elem *e;
+get_text_frame (struct supplemental_pte *spte)
+{
+	ASSERT(lock_held_by_current_thread(&spte->lock));
+	ASSERT(!spte->writable);
+	struct inode *inode = file_get_inode(spte->f);
 	struct frame_table_entry *fte;
-	struct thread* cur=thread_current();
+	size_t read_bytes = PGSIZE - spte->zero_bytes;
 
-	if (clock_hand == NULL) {
-		clock_hand = list_begin (&frame_table);
-	}
+	while (true) {
+		/*map the frame if it is there, waiting for it to be read in*/
+		lock_acquire(&frame_table_lock);
+		while ((fte = find_text(inode, spte->offset, read_bytes)) != NULL
+				&& fte->loading) {
+			cond_wait(&text_loaded, &frame_table_lock);
+		}
+		if (fte != NULL) {
+			link_spte(fte, spte);
+			lock_release(&frame_table_lock);
+			return fte;
+		}
+		lock_release(&frame_table_lock);
 
-	/* choose the frame to evict using "second-chance" algorithm */
-	while(true) {
-		if (clock_hand == list_end (&frame_table)) {
-			clock_hand = list_begin (&frame_table);
+		/*not there, read it into a new frame*/
+		fte = get_frame(spte);
+		if (fte == NULL) {
+			return NULL;
 		}
-		fte = list_entry (clock_hand, struct frame_table_entry, elem);
-		if(fte->accessed || fte->pinned ||
-				fte->spte->type_code == SPTE_CODE_SEG) {
-			fte->accessed = false;
-			clock_hand = list_next (clock_hand);
-		} else {
-
-			fte->accessed = true;
-			clock_hand = list_next (clock_hand);
+		lock_acquire(&frame_table_lock);
+		if (find_text(inode, spte->offset, read_bytes) == NULL) {
 			break;
 		}
+		/*another process loaded it while a frame was found*/
+		lock_release(&frame_table_lock);
+		frame_release(fte, spte);
 	}
+	fte->text_inode = inode;
+	fte->text_offset = spte->offset;
+	fte->text_read_bytes = read_bytes;
+	fte->loading = true;
+	hash_insert(&text_table, &fte->text_elem);
+	lock_release(&frame_table_lock);
 
-	bool already_hold_lock_old=false;
-	bool already_hold_lock=false;
-	if(fte!=NULL && !fte->pinned){
+	/*the file position is left untouched*/
+	bool success = file_read_at(spte->f, fte->frame_addr, read_bytes,
+			spte->offset) == (off_t) read_bytes;
+	memset(fte->frame_addr + read_bytes, 0, spte->zero_bytes);
 
-		/*protect old_spte and current spte*/
-		if(!lock_held_by_current_thread (&fte->spte->lock)){
-			lock_acquire(&fte->spte->lock);
-		}else{
-			already_hold_lock_old=true;
-		}
+	lock_acquire(&frame_table_lock);
+	fte->loading = false;
+	if (!success) {
+		hash_delete(&text_table, &fte->text_elem);
+		fte->text_inode = NULL;
+	}
+	cond_broadcast(&text_loaded, &frame_table_lock);
+	lock_release(&frame_table_lock);
 
-		if(!lock_held_by_current_thread (&spte->lock)){
-			lock_acquire(&spte->lock);
-		}else{
-			already_hold_lock=true;
+	/*from here the spte lock keeps it from being evicted*/
+	frame_unpin(fte);
+	if (!success) {
+		frame_release(fte, spte);
+		return NULL;
+	}
+	return fte;
+}
+
+/*evict a frame and return its frame_table_entry pointer, pinned and
+ * with no owner. returns NULL if no frame can be evicted*/
+static struct frame_table_entry *
+evict_frame(void){
+	lock_acquire (&frame_table_lock);
+	struct frame_table_entry *fte = NULL;
+	struct frame_table_entry *e;
+	size_t scan_limit = 2 * frame_cnt;
+	size_t i;
+
+	/* choose the frame to evict with a two-handed clock. the front
+	 * hand clears the accessed bits, and the back hand takes a frame
+	 * nobody touched since. two full rounds without a victim means
+	 * every frame is busy */
+	for (i = 0; i < scan_limit; i++) {
+		frame_clear_accessed(
+				&frame_table[(clock_hand + hand_spread) % frame_cnt]);
+		e = &frame_table[clock_hand];
+		clock_hand = (clock_hand + 1) % frame_cnt;
+		if (!e->in_use || e->pin_cnt > 0 || list_empty(&e->spte_list)
+				|| frame_accessed(e)) {
+			continue;
 		}
+		/*an owner may be loading or freeing this page, in which
+		 * case it holds the spte lock, so pick another frame rather
+		 * than wait on it while holding frame_table_lock*/
+		if (!lock_sptes(e)) {
+			continue;
+		}
+		fte = e;
+		break;
+	}
+	if (fte == NULL) {
+		lock_release (&frame_table_lock);
+		return NULL;
+	}
 
+	struct list_elem *le;
+	struct supplemental_pte *old_spte;
+	/*the kernel writes some pages through its own mapping*/
+	bool is_dirty = pagedir_is_dirty (init_page_dir, fte->frame_addr);
+	/*pin the fte to avoid IO conflict, need to unpin outside*/
+	fte->pin_cnt = 1;
 
-		fte->spte->fte=NULL;
+	/*unmap first, so the owners fault and wait on the spte lock
+	 * instead of changing the page while it is written out*/
+	for (le = list_begin(&fte->spte_list); le != list_end(&fte->spte_list);
+			le = list_next(le)) {
+		old_spte = list_entry(le, struct supplemental_pte, fte_elem);
+		is_dirty |= pagedir_is_dirty (old_spte->t->pagedir,
+				old_spte->uaddr);
+		pagedir_clear_page (old_spte->t->pagedir, old_spte->uaddr);
+	}
 
-		/*pin the fte to avoid IO conflict, need to unpin outside*/
-		fte->pinned=true;
-		/* swap out the frame swap pool */
-		if(fte->spte->type_code != SPTE_MMAP){
-			swap_out(fte);
-		}
+	old_spte = list_entry(list_front(&fte->spte_list),
+			struct supplemental_pte, fte_elem);
+	bool is_text = fte->text_inode != NULL;
+	if (is_text) {
+		/*text is read from the executable again by whoever needs it*/
+		hash_delete (&text_table, &fte->text_elem);
+		fte->text_inode = NULL;
+	}
 
-		/*if the block is dirty, write it back to disk*/
-		struct supplemental_pte *old_spte=fte->spte;
-		struct file* file;
-		bool is_dirty = pagedir_is_dirty (fte->t->pagedir, old_spte->uaddr);
-		if (is_dirty && old_spte->writable &&
-				old_spte->type_code == SPTE_MMAP) {
-			file = old_spte->f;
-			off_t ofs = old_spte->offset;
-			off_t page_write_bytes = PGSIZE-old_spte->zero_bytes;
-			lock_acquire(&filesys_lock);
-			fte->accessed = true;
-			file_seek(file, ofs);
-			file_write(file, fte->frame_addr, page_write_bytes);
-			lock_release(&filesys_lock);
+	/*the pin and the spte locks keep the frame and its spte_list as
+	 * they are, so swap it out without frame_table_lock and let other
+	 * faults go on meanwhile*/
+	lock_release (&frame_table_lock);
+	size_t slot = SWAP_SLOT_NONE;
+	bool saved = true;
+	if (is_text) {
+		/*nothing to save*/
+	} else if (old_spte->type_code == SPTE_MMAP) {
+		/*no mmap system call is dispatched yet, so no SPTE_MMAP page
+		 * exists and this is never taken. if the block is dirty,
+		 * write it back to disk*/
+		if (is_dirty && old_spte->writable) {
+			file_write_at(old_spte->f, fte->frame_addr,
+					PGSIZE - old_spte->zero_bytes, old_spte->offset);
 		}
+	} else if (old_spte->type_code == SPTE_DATA_SEG && !is_dirty) {
+		/*still what load_file read, so it is read again rather than
+		 * written to swap*/
+	} else {
+		slot = swap_out(fte->frame_addr, fte->ref_cnt,
+				page_swap_hint(old_spte));
+		saved = slot != SWAP_SLOT_NONE;
+	}
+	lock_acquire (&frame_table_lock);
 
-		/*update the page table*/
-		pagedir_clear_page(fte->t->pagedir,fte->spte->uaddr);
-
-		/*put the fte into the tail*/
-		list_remove(&fte->elem);
-		list_push_back(&frame_table,&fte->elem);
-		fte->accessed = true;
-		fte->spte=spte;
-		fte->t=thread_current();
-		spte->fte=fte;
-		if(!already_hold_lock_old){
-			lock_release(&old_spte->lock);
+	if (!saved) {
+		/*no swap space left, give the page back to its owners, a
+		 * shared page stays copy-on-write. the dirty bits went with
+		 * the mappings, keep them on the kernel's one*/
+		if (is_dirty) {
+			pagedir_set_dirty (init_page_dir, fte->frame_addr, true);
 		}
-		if(!already_hold_lock){
-			lock_release(&spte->lock);
+		for (le = list_begin(&fte->spte_list);
+				le != list_end(&fte->spte_list); le = list_next(le)) {
+			old_spte = list_entry(le, struct supplemental_pte, fte_elem);
+			pagedir_set_page (old_spte->t->pagedir, old_spte->uaddr,
+					fte->frame_addr,
+					old_spte->writable && fte->ref_cnt == 1);
 		}
-
+		fte->pin_cnt = 0;
+		unlock_sptes(fte, NULL);
+		lock_release (&frame_table_lock);
+		return NULL;
 	}
-	else{
-		/*cannot find a frame to evict*/
-		fte=NULL;
+
+	/*the old owners now find their page in swap or the file, each
+	 * holding one reference to the slot*/
+	while (!list_empty(&fte->spte_list)) {
+		old_spte = list_entry(list_pop_front(&fte->spte_list),
+				struct supplemental_pte, fte_elem);
+		old_spte->fte = NULL;
+		old_spte->swap_slot = slot;
+		lock_release(&old_spte->lock);
 	}
+	fte->ref_cnt = 0;
+
 	lock_release (&frame_table_lock);
 	return fte;
 }
 
-/*create a new frame_table_entry*/
-struct frame_table_entry *
-create_fte(struct thread* t,uint8_t *frame_addr,
-		struct supplemental_pte* spte){
-	struct frame_table_entry *fte=malloc(sizeof(struct frame_table_entry));
-	fte->t=t;
-	fte->frame_addr=frame_addr;
-	fte->spte=spte;
-	fte->accessed = false;
-	spte->fte=fte;
-	/*pin the fte to avoid IO conflict, need to unpin outside*/
-
-	fte->pinned=true;
-	/*add the new entry into frame_table */
+/*take the entry of FRAME_ADDR, a page just allocated from the user
+ * pool. it is returned pinned, need to unpin outside*/
+static struct frame_table_entry *
+claim_frame(uint8_t *frame_addr){
+	struct frame_table_entry *fte = frame_of(frame_addr);
 	lock_acquire(&frame_table_lock);
-	list_push_back(&frame_table,&fte->elem);
+	ASSERT(!fte->in_use && fte->ref_cnt == 0);
+	fte->in_use = true;
+	fte->pin_cnt = 1;
+	used_cnt++;
+	if (free_frame_cnt() < low_water) {
+		cond_signal(&pageout_needed, &frame_table_lock);
+	}
 	lock_release(&frame_table_lock);
-
 	return fte;
 }
 
-/*free a frame_table_entry*/
-bool
-free_fte (struct frame_table_entry *fte)
+/*give the frame FTE, which no page maps any more, back to the user
+ * pool. must hold frame_table_lock*/
+static void free_frame(struct frame_table_entry *fte) {
+	ASSERT(lock_held_by_current_thread(&frame_table_lock));
+	ASSERT(fte->in_use && fte->ref_cnt == 0);
+	/*the entry stays for the next use of the page*/
+	fte->in_use = false;
+	fte->pin_cnt = 0;
+	used_cnt--;
+	palloc_free_page(fte->frame_addr);
+}
+
+/*number of free frames in the user pool, must hold frame_table_lock*/
+static size_t free_frame_cnt(void) {
+	ASSERT(lock_held_by_current_thread(&frame_table_lock));
+	return frame_cnt - used_cnt;
+}
+
+/*page-out daemon, evicts frames in the background whenever fewer
+ * than low_water are free, until high_water are, so that a fault
+ * seldom has to wait for a page to be written out*/
+static void pageout_daemon(void *aux UNUSED) {
+	struct frame_table_entry *fte;
+	while (true) {
+		bool stalled = false;
+		lock_acquire(&frame_table_lock);
+		while (free_frame_cnt() >= low_water) {
+			cond_wait(&pageout_needed, &frame_table_lock);
+		}
+		while (free_frame_cnt() < high_water) {
+			lock_release(&frame_table_lock);
+			fte = evict_frame();
+			lock_acquire(&frame_table_lock);
+			if (fte == NULL) {
+				stalled = true;
+				break;
+			}
+			free_frame(fte);
+		}
+		lock_release(&frame_table_lock);
+		if (stalled) {
+			/*every frame is pinned, busy or recently used, or swap
+			 * is full, give the owners time to let some go*/
+			timer_sleep(PAGEOUT_RETRY_TICKS);
+		}
+	}
+}
+
+/*drop SPTE's reference to its frame FTE, which SPTE must no longer
+ * map. the frame is freed with its last reference*/
+void
+frame_release (struct frame_table_entry *fte,
+		struct supplemental_pte *spte)
 {
   lock_acquire (&frame_table_lock);
-  if(fte->pinned){
-	  /*cannot deallocate when it is pinned*/
+  ASSERT (spte->fte == fte);
+  list_remove (&spte->fte_elem);
+  spte->fte = NULL;
+  if (--fte->ref_cnt > 0) {
 	  lock_release (&frame_table_lock);
-	  return false;
+	  return;
   }
 
-  /* update clock hand */
-  if (&fte->elem == clock_hand) {
-	  clock_hand = list_next (clock_hand);
-	  if (clock_hand == list_end(&frame_table)) {
-		  clock_hand = list_begin(&frame_table);
-	  }
+  if (fte->text_inode != NULL) {
+	  hash_delete (&text_table, &fte->text_elem);
+	  fte->text_inode = NULL;
   }
 
-  /*clean up*/
-  list_remove (&fte->elem);
-  palloc_free_page(fte->frame_addr);
-  free(fte);
-
+  free_frame (fte);
   lock_release (&frame_table_lock);
+}
 
-  return true;
+/*the frame FTE holds just what its page's file has, so eviction can
+ * drop it unless it is written from now on. clears the dirty bit of
+ * the kernel's mapping, through which it was read in*/
+void frame_mark_clean(struct frame_table_entry *fte) {
+	pagedir_set_dirty(init_page_dir, fte->frame_addr, false);
+}
+
+/*whether enough frames are free that taking one more does not wake
+ * the page-out daemon, for pages loaded before they are touched*/
+bool frame_has_spare(void) {
+	lock_acquire(&frame_table_lock);
+	bool spare = free_frame_cnt() >= high_water;
+	lock_release(&frame_table_lock);
+	return spare;
+}
+
+/*whether a page mapping FTE, or the kernel through its own mapping
+ * of the frame, accessed it since the front hand cleared the accessed
+ * bits. must hold frame_table_lock, which keeps the owners' page dirs
+ * alive*/
+static bool frame_accessed(struct frame_table_entry *fte) {
+	ASSERT(lock_held_by_current_thread(&frame_table_lock));
+	struct list_elem *e;
+	if (pagedir_is_accessed(init_page_dir, fte->frame_addr)) {
+		return true;
+	}
+	for (e = list_begin(&fte->spte_list); e != list_end(&fte->spte_list);
+			e = list_next(e)) {
+		struct supplemental_pte *spte = list_entry(e,
+				struct supplemental_pte, fte_elem);
+		if (pagedir_is_accessed(spte->t->pagedir, spte->uaddr)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*clear the accessed bits frame_accessed looks at, must hold
+ * frame_table_lock*/
+static void frame_clear_accessed(struct frame_table_entry *fte) {
+	ASSERT(lock_held_by_current_thread(&frame_table_lock));
+	struct list_elem *e;
+	if (!fte->in_use) {
+		return;
+	}
+	/*clearing the kernel's bit flushes the TLB, so only if it is set*/
+	if (pagedir_is_accessed(init_page_dir, fte->frame_addr)) {
+		pagedir_set_accessed(init_page_dir, fte->frame_addr, false);
+	}
+	for (e = list_begin(&fte->spte_list); e != list_end(&fte->spte_list);
+			e = list_next(e)) {
+		struct supplemental_pte *spte = list_entry(e,
+				struct supplemental_pte, fte_elem);
+		pagedir_set_accessed(spte->t->pagedir, spte->uaddr, false);
+	}
+}
+
+/*the entry of the user pool page at FRAME_ADDR*/
+static struct frame_table_entry *frame_of(const void *frame_addr) {
+	size_t idx = pg_no(frame_addr) - pg_no(frame_base);
+	ASSERT(pg_ofs(frame_addr) == 0 && idx < frame_cnt);
+	return &frame_table[idx];
+}
+
+/*make SPTE one of the pages mapping FTE, must hold frame_table_lock*/
+static void link_spte(struct frame_table_entry *fte,
+		struct supplemental_pte *spte) {
+	ASSERT(lock_held_by_current_thread(&frame_table_lock));
+	list_push_back(&fte->spte_list, &spte->fte_elem);
+	fte->ref_cnt++;
+	spte->fte = fte;
+}
+
+/*try to lock every spte mapping FTE, without waiting. returns false,
+ * with none of them locked, if any is busy*/
+static bool lock_sptes(struct frame_table_entry *fte) {
+	struct list_elem *e;
+	for (e = list_begin(&fte->spte_list); e != list_end(&fte->spte_list);
+			e = list_next(e)) {
+		struct lock *l = &list_entry(e, struct supplemental_pte,
+				fte_elem)->lock;
+		if (lock_held_by_current_thread(l) || !lock_try_acquire(l)) {
+			unlock_sptes(fte, e);
+			return false;
+		}
+	}
+	return true;
+}
+
+/*release the spte locks taken by lock_sptes, up to STOP or all of
+ * them if STOP is NULL*/
+static void unlock_sptes(struct frame_table_entry *fte,
+		struct list_elem *stop) {
+	struct list_elem *e;
+	for (e = list_begin(&fte->spte_list);
+			e != list_end(&fte->spte_list) && e != stop; e = list_next(e)) {
+		lock_release(&list_entry(e, struct supplemental_pte,
+				fte_elem)->lock);
+	}
+}
+
+/*find the text frame of READ_BYTES of INODE at OFFSET, must hold
+ * frame_table_lock. two segments may share a file page, with a
+ * different part of it zeroed*/
+static struct frame_table_entry *find_text(struct inode *inode,
+		off_t offset, size_t read_bytes) {
+	ASSERT(lock_held_by_current_thread(&frame_table_lock));
+	struct frame_table_entry key;
+	key.text_inode = inode;
+	key.text_offset = offset;
+	key.text_read_bytes = read_bytes;
+	struct hash_elem *e = hash_find(&text_table, &key.text_elem);
+	return e != NULL ? hash_entry(e, struct frame_table_entry, text_elem)
+			: NULL;
+}
+
+/*hash function for text_table*/
+static unsigned text_hash_func(const struct hash_elem *e,
+		void *aux UNUSED) {
+	const struct frame_table_entry *fte = hash_entry(e,
+			struct frame_table_entry, text_elem);
+	return hash_int((int) fte->text_inode) ^ hash_int(fte->text_offset);
+}
+
+/*less function for text_table*/
+static bool text_less_func(const struct hash_elem *a,
+		const struct hash_elem *b, void *aux UNUSED) {
+	const struct frame_table_entry *fa = hash_entry(a,
+			struct frame_table_entry, text_elem);
+	const struct frame_table_entry *fb = hash_entry(b,
+			struct frame_table_entry, text_elem);
+	if (fa->text_inode != fb->text_inode) {
+		return fa->text_inode < fb->text_inode;
+	}
+	if (fa->text_offset != fb->text_offset) {
+		return fa->text_offset < fb->text_offset;
+	}
+	return fa->text_read_bytes < fb->text_read_bytes;
 }
@@ -4,21 +4,43 @@
 #include <stdint.h>
 #include <debug.h>
 #include <hash.h>
+#include <list.h>
 #include "threads/thread.h"
+#include "filesys/off_t.h"
 #include "vm/page.h"
 
-void frame_table_init();
+void frame_table_init(void);
+void *frame_zero_page(void);
 struct frame_table_entry* get_frame(struct supplemental_pte *spte);
-bool free_fte (struct frame_table_entry *fte);
+struct frame_table_entry *get_text_frame(struct supplemental_pte *spte);
+bool frame_has_text(const struct supplemental_pte *spte);
+void frame_share(struct frame_table_entry *fte, struct supplemental_pte *spte);
+bool frame_unshare(struct supplemental_pte *spte);
+void frame_mark_clean(struct frame_table_entry *fte);
+bool frame_has_spare(void);
+void frame_pin(struct frame_table_entry *fte);
+void frame_unpin(struct frame_table_entry *fte);
+void frame_release(struct frame_table_entry *fte,
+		struct supplemental_pte *spte);
 
+/*one for each page of the user pool, in an array indexed by the
+ * page*/
 struct frame_table_entry
 {
-  struct thread *t;		/* the thread who own this entry */
   uint8_t *frame_addr;		/* the actual frame address */
-  struct list_elem elem;	/* Linked list of frame entries */
-  bool pinned;			/* whether this frame is pinned  */
-  struct supplemental_pte* spte; /*the corresponding spte*/
-  bool accessed;        /*indicator of the frame is accessed*/
+  bool in_use;                  /*whether the page is allocated*/
+  int pin_cnt;                  /*number of pins, the frame is not
+                                  evicted while it is pinned*/
+  struct list spte_list;        /*sptes of the pages mapping this frame*/
+  int ref_cnt;                  /*number of sptes in spte_list*/
+
+  struct inode *text_inode;     /*executable of a shared text frame,
+                                  NULL for other frames*/
+  off_t text_offset;            /*offset of the text page in text_inode*/
+  size_t text_read_bytes;       /*bytes of the text page from the file,
+                                  the rest is zeroed*/
+  bool loading;                 /*whether the text page is being read in*/
+  struct hash_elem text_elem;   /*hash elem for the text table*/
 };
 
 #endif
@@ -2,124 +2,396 @@
 #include "vm/frame.h"
 #include "vm/swap.h"
 #include "threads/vaddr.h"
+#include "threads/malloc.h"
 #include <hash.h>
+#include <string.h>
 #include "filesys/file.h"
-#include "userprog/syscall.h"
-
-bool load_file(struct supplemental_pte *spte);
-bool extend_stack(struct supplemental_pte *spte);
-
-/*load page based on the spte's type_code*/
-bool try_load_page(void* fault_addr){
-	ASSERT (fault_addr < PHYS_BASE);
-	/* Round down to nearest page boundary. */
-	uint8_t* target_addr = (uint8_t*)pg_round_down (fault_addr);
-	bool result = false;
-	struct thread* cur= thread_current();
-	ASSERT(cur != NULL);
-	/*creat key elem for searching*/
-	struct supplemental_pte key;
-	key.uaddr=target_addr;
+#include "filesys/inode.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+
+#define FAULT_AROUND_MIN 2   /*pages mapped after a fault that does not
+                               follow the last one*/
+#define FAULT_AROUND_MAX 16  /*most pages mapped after a fault*/
+
+static bool load_page(struct supplemental_pte *spte, bool write);
+static bool is_file_page(const struct supplemental_pte *spte);
+static bool is_cached_page(const struct supplemental_pte *spte);
+static void fault_around(const uint8_t *upage);
+static bool map_zero_page(struct supplemental_pte *spte);
+static bool load_file(struct supplemental_pte *spte);
+static bool extend_stack(struct supplemental_pte *spte);
+static bool fork_spte(struct supplemental_pte *pspte, struct thread *parent);
+static struct supplemental_pte *create_spte(uint8_t *uaddr,
+		uint8_t type_code, bool writable);
+static struct supplemental_pte *find_spte(const void *uaddr);
+static void destroy_spte(struct hash_elem *e, void *aux);
+static unsigned spte_hash_func(const struct hash_elem *e, void *aux);
+static bool spte_less_func(const struct hash_elem *a,
+		const struct hash_elem *b, void *aux);
+
+/*init the current thread's supplemental page table*/
+bool page_table_init(void) {
+	struct thread *cur = thread_current();
+	lock_init(&cur->supplemental_pt_lock);
+	return hash_init(&cur->supplemental_pt, spte_hash_func,
+			spte_less_func, NULL);
+}
+
+/*free every page of the current thread, in memory or in swap. must
+ * be called before the page dir is destroyed, since the frames are
+ * unmapped and returned to the frame table here*/
+void page_table_destroy(void) {
+	struct thread *cur = thread_current();
+	/*the table is set up iff its buckets are allocated*/
+	if (cur->supplemental_pt.buckets == NULL) {
+		return;
+	}
 	lock_acquire(&cur->supplemental_pt_lock);
-	struct hash_elem *e = hash_find (&cur->supplemental_pt, &key.elem);
+	hash_destroy(&cur->supplemental_pt, destroy_spte);
+	cur->supplemental_pt.buckets = NULL;
+	lock_release(&cur->supplemental_pt_lock);
+}
+
+/*copy the pages of PARENT, which waits in fork, into the current
+ * thread, whose page dir and supplemental page table are set up and
+ * whose exec file is open. pages in memory are shared copy-on-write,
+ * pages in swap share the slot and the rest are loaded again when
+ * touched. returns false if memory runs out*/
+bool page_table_fork(struct thread *parent) {
+	struct hash_iterator i;
+	bool success = true;
+	lock_acquire(&parent->supplemental_pt_lock);
+	hash_first(&i, &parent->supplemental_pt);
+	while (success && hash_next(&i)) {
+		success = fork_spte(hash_entry(hash_cur(&i),
+				struct supplemental_pte, elem), parent);
+	}
+	lock_release(&parent->supplemental_pt_lock);
+	return success;
+}
 
-	if(e==NULL){
-		/*if not found, return false*/
-		lock_release(&cur->supplemental_pt_lock);
+/*record that the page at UADDR is READ_BYTES from F at OFFSET,
+ * followed by zeros. nothing is read until the page is touched*/
+bool page_add_file(struct file *f, off_t offset, uint8_t *uaddr,
+		size_t read_bytes, bool writable) {
+	ASSERT(read_bytes <= PGSIZE);
+	struct supplemental_pte *spte = create_spte(uaddr,
+			writable ? SPTE_DATA_SEG : SPTE_CODE_SEG, writable);
+	if (spte == NULL) {
 		return false;
 	}
+	spte->f = f;
+	spte->offset = offset;
+	spte->zero_bytes = PGSIZE - read_bytes;
+	return true;
+}
 
-	/*get the entry and release lock*/
-	struct supplemental_pte *spte = hash_entry (e, struct supplemental_pte,
-			elem);
-	ASSERT(spte != NULL);
+/*load page based on the spte's type_code, for a WRITE access or a
+ * read*/
+bool try_load_page(void* fault_addr, bool write){
+	ASSERT (is_user_vaddr(fault_addr));
+	struct supplemental_pte *spte = find_spte(fault_addr);
+	if (spte == NULL) {
+		return false;
+	}
 	lock_acquire(&spte->lock);
-	lock_release(&cur->supplemental_pt_lock);
+	/*another access may have brought it in already*/
+	bool loaded = spte->fte != NULL || spte->zero_mapped;
+	bool from_file = !loaded && is_file_page(spte);
+	bool result = loaded || load_page(spte, write);
+	lock_release(&spte->lock);
+	if (result && from_file) {
+		fault_around(spte->uaddr);
+	}
+	return result;
+}
+
+/*judge if FAULT_ADDR is a stack access of the user stack at ESP,
+ * and if so map a new zeroed page for it, the shared zero page
+ * unless it is for a WRITE*/
+bool grow_stack(void *fault_addr, void *esp, bool write) {
+	uint8_t *addr = fault_addr;
+	/*PUSHA may touch 32 bytes below esp before moving it*/
+	if (!is_user_vaddr(addr) || addr < (uint8_t *) PHYS_BASE - STACK_MAX
+			|| esp == NULL || addr + 32 < (uint8_t *) esp) {
+		return false;
+	}
+	uint8_t *upage = pg_round_down(addr);
+	struct supplemental_pte *spte = create_spte(upage, SPTE_STACK_INIT,
+			true);
+	if (spte == NULL) {
+		return false;
+	}
+	spte->zero_bytes = PGSIZE;
+	return try_load_page(upage, write);
+}
+
+/*give the current thread its own copy of the copy-on-write page at
+ * FAULT_ADDR, which it tried to write. returns false if the page is
+ * not writable at all*/
+bool page_unshare(void *fault_addr) {
+	ASSERT (is_user_vaddr(fault_addr));
+	struct supplemental_pte *spte = find_spte(fault_addr);
+	if (spte == NULL || !spte->writable) {
+		return false;
+	}
+	lock_acquire(&spte->lock);
+	/*if it was evicted meanwhile, the retry faults it back in*/
+	bool result = spte->zero_mapped ? load_page(spte, true)
+			: spte->fte == NULL || frame_unshare(spte);
+	lock_release(&spte->lock);
+	return result;
+}
+
+/*the swap slot right after the one of the page below SPTE's in the
+ * same process, so that pages evicted one after another from adjacent
+ * addresses land in adjacent slots. SWAP_SLOT_NONE if that page is not
+ * in swap or its table is busy, eviction does not wait for it*/
+size_t page_swap_hint(const struct supplemental_pte *spte) {
+	struct thread *t = spte->t;
+	struct supplemental_pte key;
+	size_t slot = SWAP_SLOT_NONE;
+	if (spte->uaddr == NULL || lock_held_by_current_thread(
+			&t->supplemental_pt_lock)
+			|| !lock_try_acquire(&t->supplemental_pt_lock)) {
+		return SWAP_SLOT_NONE;
+	}
+	key.uaddr = spte->uaddr - PGSIZE;
+	struct hash_elem *e = hash_find(&t->supplemental_pt, &key.elem);
+	if (e != NULL) {
+		/*read without its lock, a stale slot only misplaces the page*/
+		slot = hash_entry(e, struct supplemental_pte, elem)->swap_slot;
+	}
+	lock_release(&t->supplemental_pt_lock);
+	return slot != SWAP_SLOT_NONE ? slot + 1 : SWAP_SLOT_NONE;
+}
+
+/*bring in and pin every page of [UADDR, UADDR+SIZE), so the kernel
+ * can work on the buffer without faulting while it holds locks. a
+ * writable page is made our own first, so that a copy-on-write fault
+ * never moves it off its pinned frame. returns false, with nothing
+ * pinned, if a page can not be loaded or the kernel is to WRITE a
+ * read-only page*/
+bool page_pin_range(const void *uaddr, size_t size, bool write) {
+	const uint8_t *start = pg_round_down(uaddr);
+	const uint8_t *end = (const uint8_t *) uaddr + size;
+	const uint8_t *p;
+	if (size == 0) {
+		return true;
+	}
+	for (p = start; p < end; p += PGSIZE) {
+		struct supplemental_pte *spte = find_spte(p);
+		bool success = false;
+		if (spte != NULL) {
+			lock_acquire(&spte->lock);
+			if ((spte->fte != NULL || load_page(spte, true))
+					&& (spte->writable ? frame_unshare(spte) : !write)) {
+				frame_pin(spte->fte);
+				success = true;
+			}
+			lock_release(&spte->lock);
+		}
+		if (!success) {
+			page_unpin_range(start, p - start);
+			return false;
+		}
+	}
+	return true;
+}
+
+/*unpin the pages of [UADDR, UADDR+SIZE) pinned by page_pin_range*/
+void page_unpin_range(const void *uaddr, size_t size) {
+	const uint8_t *end = (const uint8_t *) uaddr + size;
+	const uint8_t *p;
+	if (size == 0) {
+		return;
+	}
+	for (p = pg_round_down(uaddr); p < end; p += PGSIZE) {
+		struct supplemental_pte *spte = find_spte(p);
+		if (spte != NULL) {
+			lock_acquire(&spte->lock);
+			if (spte->fte != NULL) {
+				frame_unpin(spte->fte);
+			}
+			lock_release(&spte->lock);
+		}
+	}
+}
+
+/*bring SPTE's page into a frame, must hold spte->lock. a read of a
+ * page that is all zeros maps the shared zero page, and only a WRITE
+ * or a pin takes a frame*/
+static bool load_page(struct supplemental_pte *spte, bool write) {
+	ASSERT(lock_held_by_current_thread(&spte->lock));
+	ASSERT(spte->fte == NULL);
+
+	if (spte->zero_mapped) {
+		/*the first write, give it a zeroed frame of its own*/
+		pagedir_clear_page(spte->t->pagedir, spte->uaddr);
+		spte->zero_mapped = false;
+	} else if (!write && spte->swap_slot == SWAP_SLOT_NONE
+			&& spte->zero_bytes == PGSIZE
+			&& (spte->type_code == SPTE_DATA_SEG
+					|| spte->type_code == SPTE_STACK_INIT)) {
+		return map_zero_page(spte);
+	}
 
 	/*handle the page is in swap*/
-	if (spte->spb != NULL) {
+	if (spte->swap_slot != SWAP_SLOT_NONE) {
 		/* swap in the frame from swap pool */
 		struct frame_table_entry *fte = get_frame(spte);
 		if (fte == NULL) {
-			lock_release(&spte->lock);
 			return false;
 		}
-		swap_in(fte, spte->spb);
+		swap_in(fte->frame_addr, spte->swap_slot);
+		/* indicate the spte is not swapped */
+		spte->swap_slot = SWAP_SLOT_NONE;
 		bool success = install_page (spte->uaddr, fte->frame_addr,
 				spte->writable);
+		frame_unpin(fte);
 		if (!success) {
-			free_fte(fte);
-			lock_release(&spte->lock);
+			frame_release(fte, spte);
 			return false;
 		}
-		fte->pinned = false;
-		result = true;
-	} else {
-		/*handle the page not in swap, based on its type_code*/
-		if (spte->type_code == SPTE_CODE_SEG ||
-				spte->type_code == SPTE_DATA_SEG ||
-				spte->type_code == SPTE_MMAP) {
-				/* load file from disk into frame */
-				result = load_file(spte);
-		} else if (spte->type_code ==SPTE_STACK_INIT){
-			/*deal with stack extension*/
-			result = extend_stack(spte);
-		}
-		else {
-			PANIC("invalid spte type_code!");
-		}
+		return true;
 	}
 
-	lock_release(&spte->lock);
-
-	return result;
+	/*handle the page not in swap, based on its type_code*/
+	if (spte->type_code == SPTE_CODE_SEG ||
+			spte->type_code == SPTE_DATA_SEG ||
+			spte->type_code == SPTE_MMAP) {
+		/* load file from disk into frame */
+		return load_file(spte);
+	} else if (spte->type_code == SPTE_STACK_INIT) {
+		/*deal with stack extension*/
+		return extend_stack(spte);
+	}
+	PANIC("invalid spte type_code!");
 }
 
 /*load file based on its spte's type_code*/
-bool load_file(struct supplemental_pte *spte) {
+static bool load_file(struct supplemental_pte *spte) {
 	ASSERT(spte != NULL);
 
+	struct frame_table_entry *fte;
+	/*read-only text is shared by all processes running the file*/
+	if (spte->type_code == SPTE_CODE_SEG) {
+		fte = get_text_frame(spte);
+		if (fte == NULL) {
+			return false;
+		}
+		if (!install_page (spte->uaddr, fte->frame_addr, false)) {
+			frame_release (fte, spte);
+			return false;
+		}
+		return true;
+	}
+
 	/*get a frame*/
-	struct frame_table_entry *fte = get_frame(spte);
+	fte = get_frame(spte);
 	if (fte == NULL) {
 		return false;
 	}
 
 	struct file *f = spte->f;
 	ASSERT(f != NULL);
-	off_t offset = spte->offset;
 	size_t zero_bytes = spte->zero_bytes;
 	size_t read_bytes = PGSIZE - zero_bytes;
 
-	off_t old_pos = file_tell (f);
-	lock_acquire(&filesys_lock);
-	file_seek(f, offset);
-	fte->accessed = true;
-	/*load file from file system*/
-	if (file_read (f, fte->frame_addr, read_bytes) != read_bytes) {
-		file_seek (f, old_pos);
-		free_fte (fte);
-		lock_release(&filesys_lock);
+	/*load file from file system, the file position is left untouched*/
+	if (file_read_at (f, fte->frame_addr, read_bytes, spte->offset)
+			!= (off_t) read_bytes) {
+		frame_release (fte, spte);
 		return false;
 	}
-	file_seek (f, old_pos);
-	lock_release(&filesys_lock);
 	memset(fte->frame_addr+read_bytes, 0, zero_bytes);
+	/*eviction may drop it until the user writes it*/
+	frame_mark_clean(fte);
 
 	bool success = install_page (spte->uaddr, fte->frame_addr,
 			spte->writable);
 
 	/*finished the memset, unpin the frame*/
-	fte->pinned=false;
+	frame_unpin(fte);
 	if (!success) {
-		free_fte (fte);
+		frame_release (fte, spte);
+		return false;
+	}
+	return true;
+}
+
+/*whether SPTE's page is read from its file when it is loaded*/
+static bool is_file_page(const struct supplemental_pte *spte) {
+	return spte->swap_slot == SWAP_SLOT_NONE
+			&& (spte->type_code == SPTE_CODE_SEG
+					|| spte->type_code == SPTE_DATA_SEG);
+}
+
+/*whether SPTE's file page can be loaded without disk I/O: a text page
+ * another process has in a frame, or one whose file data is all in
+ * the buffer cache*/
+static bool is_cached_page(const struct supplemental_pte *spte) {
+	size_t read_bytes = PGSIZE - spte->zero_bytes;
+	if (spte->type_code == SPTE_CODE_SEG && frame_has_text(spte)) {
+		return true;
+	}
+	return read_bytes == 0 || inode_cached(file_get_inode(spte->f),
+			spte->offset, read_bytes);
+}
+
+/*load the file pages right after UPAGE, which just faulted in from
+ * its file, so that a sequential scan of the code or data takes one
+ * fault per window rather than one per page. the window doubles while
+ * each fault lands where the last fault-around stopped and starts over
+ * on a jump. it stops at the first page that is not a file page, is
+ * busy or would need disk I/O, and while frames are short, so that it
+ * never evicts or blocks the fault on the disk*/
+static void fault_around(const uint8_t *upage) {
+	struct thread *cur = thread_current();
+	const uint8_t *p = upage + PGSIZE;
+	size_t i;
+
+	if (upage == cur->fault_around_next && cur->fault_around_window > 0) {
+		cur->fault_around_window *= 2;
+		if (cur->fault_around_window > FAULT_AROUND_MAX) {
+			cur->fault_around_window = FAULT_AROUND_MAX;
+		}
+	} else {
+		cur->fault_around_window = FAULT_AROUND_MIN;
+	}
+
+	for (i = 0; i < cur->fault_around_window && is_user_vaddr(p);
+			i++, p += PGSIZE) {
+		struct supplemental_pte *spte = find_spte(p);
+		if (spte == NULL || !frame_has_spare()
+				|| lock_held_by_current_thread(&spte->lock)
+				|| !lock_try_acquire(&spte->lock)) {
+			break;
+		}
+		bool success = spte->fte != NULL || spte->zero_mapped
+				|| (is_file_page(spte) && is_cached_page(spte)
+						&& load_page(spte, false));
+		lock_release(&spte->lock);
+		if (!success) {
+			break;
+		}
+	}
+	cur->fault_around_next = (uint8_t *) p;
+}
+
+/*map the shared zero page read-only for SPTE, a write faults to
+ * load_page again*/
+static bool map_zero_page(struct supplemental_pte *spte) {
+	if (!install_page(spte->uaddr, frame_zero_page(), false)) {
 		return false;
 	}
+	spte->zero_mapped = true;
 	return true;
 }
 
 /*handle stack growth*/
-bool extend_stack(struct supplemental_pte *spte) {
+static bool extend_stack(struct supplemental_pte *spte) {
 	ASSERT(spte != NULL);
 	ASSERT(spte->type_code == SPTE_STACK_INIT);
 
@@ -130,19 +402,147 @@ bool extend_stack(struct supplemental_pte *spte) {
 	}
 
 	size_t zero_bytes = spte->zero_bytes;
-	fte->accessed = true;
 	/*zero the whole page*/
 	memset(fte->frame_addr, 0, zero_bytes);
 
 	bool success = install_page (spte->uaddr, fte->frame_addr,
 			spte->writable);
 	/*finished the memset, unpin the frame*/
-	fte->pinned=false;
+	frame_unpin(fte);
 	if (!success) {
-		free_fte (fte);
+		frame_release (fte, spte);
 		return false;
 	}
 	return true;
 }
 
+/*copy PARENT's page PSPTE into the current thread*/
+static bool fork_spte(struct supplemental_pte *pspte, struct thread *parent) {
+	/*mappings are not inherited*/
+	if (pspte->type_code == SPTE_MMAP) {
+		return true;
+	}
+	struct thread *cur = thread_current();
+	struct supplemental_pte *spte = create_spte(pspte->uaddr,
+			pspte->type_code, pspte->writable);
+	if (spte == NULL) {
+		return false;
+	}
+	spte->f = pspte->f == parent->exec_file_ptr ? cur->exec_file_ptr
+			: pspte->f;
+	spte->offset = pspte->offset;
+	spte->zero_bytes = pspte->zero_bytes;
+
+	bool success = true;
+	lock_acquire(&pspte->lock);
+	struct frame_table_entry *pfte = pspte->fte;
+	if (pfte != NULL && pfte->pin_cnt > 0 && pspte->writable) {
+		/*the kernel may be writing a pinned page behind the page
+		 * table, as async I/O does, so the child gets a copy now*/
+		struct frame_table_entry *fte = get_frame(spte);
+		if (fte == NULL) {
+			success = false;
+		} else {
+			memcpy(fte->frame_addr, pfte->frame_addr, PGSIZE);
+			success = install_page(spte->uaddr, fte->frame_addr, true);
+			frame_unpin(fte);
+			if (!success) {
+				frame_release(fte, spte);
+			}
+		}
+	} else if (pfte != NULL) {
+		/*both map the frame read-only until one of them writes*/
+		frame_share(pfte, spte);
+		success = install_page(spte->uaddr, pfte->frame_addr, false);
+		if (!success) {
+			frame_release(pfte, spte);
+		} else if (pspte->writable) {
+			pagedir_set_writable(parent->pagedir, pspte->uaddr, false);
+		}
+	} else if (pspte->zero_mapped) {
+		success = map_zero_page(spte);
+	} else if (pspte->swap_slot != SWAP_SLOT_NONE) {
+		spte->swap_slot = swap_dup(pspte->swap_slot);
+	}
+	lock_release(&pspte->lock);
+	return success;
+}
 
+/*create an spte for the page at UADDR in the current thread's
+ * supplemental page table, NULL if UADDR already has one*/
+static struct supplemental_pte *create_spte(uint8_t *uaddr,
+		uint8_t type_code, bool writable) {
+	ASSERT(pg_ofs(uaddr) == 0);
+	struct thread *cur = thread_current();
+	struct supplemental_pte *spte = calloc(1,
+			sizeof(struct supplemental_pte));
+	if (spte == NULL) {
+		return NULL;
+	}
+	spte->type_code = type_code;
+	spte->t = cur;
+	spte->uaddr = uaddr;
+	spte->writable = writable;
+	spte->swap_slot = SWAP_SLOT_NONE;
+	lock_init(&spte->lock);
+
+	lock_acquire(&cur->supplemental_pt_lock);
+	struct hash_elem *old = hash_insert(&cur->supplemental_pt, &spte->elem);
+	lock_release(&cur->supplemental_pt_lock);
+	if (old != NULL) {
+		free(spte);
+		return NULL;
+	}
+	return spte;
+}
+
+/*find the spte of the page holding UADDR in the current thread*/
+static struct supplemental_pte *find_spte(const void *uaddr) {
+	struct thread *cur = thread_current();
+	/*creat key elem for searching*/
+	struct supplemental_pte key;
+	key.uaddr = pg_round_down(uaddr);
+	lock_acquire(&cur->supplemental_pt_lock);
+	struct hash_elem *e = hash_find(&cur->supplemental_pt, &key.elem);
+	lock_release(&cur->supplemental_pt_lock);
+	return e != NULL ? hash_entry(e, struct supplemental_pte, elem) : NULL;
+}
+
+/*release the frame or swap slot of an spte and free it, used by
+ * page_table_destroy*/
+static void destroy_spte(struct hash_elem *e, void *aux UNUSED) {
+	struct supplemental_pte *spte = hash_entry(e, struct supplemental_pte,
+			elem);
+	/*wait for an eviction of this page to finish*/
+	lock_acquire(&spte->lock);
+	if (spte->fte != NULL) {
+		pagedir_clear_page(thread_current()->pagedir, spte->uaddr);
+		frame_release(spte->fte, spte);
+	}
+	/*pagedir_destroy must not free the zero page*/
+	if (spte->zero_mapped) {
+		pagedir_clear_page(thread_current()->pagedir, spte->uaddr);
+		spte->zero_mapped = false;
+	}
+	if (spte->swap_slot != SWAP_SLOT_NONE) {
+		swap_free(spte->swap_slot);
+		spte->swap_slot = SWAP_SLOT_NONE;
+	}
+	lock_release(&spte->lock);
+	free(spte);
+}
+
+/*hash function for supplemental_pt*/
+static unsigned spte_hash_func(const struct hash_elem *e,
+		void *aux UNUSED) {
+	const struct supplemental_pte *spte = hash_entry(e,
+			struct supplemental_pte, elem);
+	return hash_int((int) spte->uaddr);
+}
+
+/*less function for supplemental_pt*/
+static bool spte_less_func(const struct hash_elem *a,
+		const struct hash_elem *b, void *aux UNUSED) {
+	return hash_entry(a, struct supplemental_pte, elem)->uaddr
+			< hash_entry(b, struct supplemental_pte, elem)->uaddr;
+}
@@ -3,20 +3,21 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <debug.h>
 #include <hash.h>
 #include "threads/thread.h"
+#include "threads/synch.h"
 #include "filesys/off_t.h"
 
-/*these are the flag values stand for code 
+/*these are the flag values stand for code
  * segment, data segment, stack part and mmap part*/
 #define SPTE_CODE_SEG 1     /*spte for code segment*/
 #define SPTE_DATA_SEG 2     /*spte for data segment*/
 #define SPTE_STACK_INIT 3   /*spte for stack*/
 #define SPTE_MMAP 4         /*spte for mmap file*/
 
-bool try_load_page(void* fault_addr);
-
+#define STACK_MAX (8 * 1024 * 1024)  /*the upper limit of the stack size*/
 
 struct supplemental_pte {
 	  uint8_t type_code;		/* type of this spte entry to find the content */
@@ -29,10 +30,26 @@ struct supplemental_pte {
 	  size_t zero_bytes;		/* zero bytes number in this page */
 
 	  struct hash_elem elem;	/* hash elem for the spte in thread's hash table */
+	  struct thread *t;     /*the thread who own this page*/
 	  struct frame_table_entry* fte;  /*corresponding frame in memory*/
+	  struct list_elem fte_elem;  /*list elem for the fte's spte_list*/
 	  struct lock lock;     /*lock for this struct*/
-	  struct swap_page_block *spb;  /*swap location*/
+	  size_t swap_slot;     /*swap location, SWAP_SLOT_NONE if the page
+	                          is not in swap*/
+	  bool zero_mapped;     /*mapped to the shared zero page, read-only
+	                          and with no frame of its own*/
 };
 
+bool page_table_init(void);
+void page_table_destroy(void);
+bool page_table_fork(struct thread *parent);
+bool page_add_file(struct file *f, off_t offset, uint8_t *uaddr,
+		size_t read_bytes, bool writable);
+bool try_load_page(void* fault_addr, bool write);
+bool grow_stack(void *fault_addr, void *esp, bool write);
+bool page_unshare(void *fault_addr);
+size_t page_swap_hint(const struct supplemental_pte *spte);
+bool page_pin_range(const void *uaddr, size_t size, bool write);
+void page_unpin_range(const void *uaddr, size_t size);
 
 #endif /* vm/page.h */
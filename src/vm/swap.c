@@ -1,107 +1,296 @@
 #include "vm/swap.h"
 
+#include <bitmap.h>
 #include <debug.h>
-
-
-#define BLOCKS_UNIT_NUMBER 8   /*each page corresponds to 8 blocks in disk*/
-
-static struct list swap_space_pool;  /* swap table */
-static struct lock swap_space_pool_lock; /* the lock of swap table */
-
-struct block *swap_block;
-struct swap_page_block *get_free_spb();
-void put_back_spb(struct swap_page_block *spb);
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+
+#define BLOCKS_UNIT_NUMBER (PGSIZE / BLOCK_SECTOR_SIZE)  /*each page
+                                   corresponds to 8 blocks in disk*/
+
+static struct bitmap *used_slots;   /* swap table, a bit per slot */
+static struct bitmap *writing_slots;  /* slots swap_out is writing */
+static uint16_t *slot_refs;         /* pages holding each used slot */
+static size_t next_slot;            /* where the next search starts */
+static struct lock swap_lock;       /* the lock of the swap table */
+
+static struct block *swap_block;   /* the swap device, NULL if none */
+
+#define SWAP_CACHE_SIZE 16   /* pages of slots read ahead */
+#define SWAP_READ_AHEAD 4    /* slots read ahead after a swap in */
+
+/* states of a swap cache entry */
+enum swap_cache_state {
+	SC_EMPTY,      /* holds nothing */
+	SC_QUEUED,     /* slot waits for the read-ahead daemon */
+	SC_LOADING,    /* slot is being read in */
+	SC_READY       /* page holds the slot */
+};
+
+/* a slot read ahead, swapped in later without I/O */
+struct swap_cache_entry {
+	size_t slot;                  /* the slot, if not SC_EMPTY */
+	enum swap_cache_state state;  /* what the entry holds */
+	bool stale;                   /* slot freed while it was loading */
+	void *page;                   /* kernel page the slot is read into */
+};
+
+/* the swap cache, with swap_lock */
+static struct swap_cache_entry swap_cache[SWAP_CACHE_SIZE];
+static size_t cache_hand;            /* where the next entry is taken */
+static struct condition read_ahead_queued;  /* an entry got queued */
+static struct condition read_ahead_done;    /* an entry got loaded */
+
+static size_t alloc_slot(size_t hint, int ref_cnt);
+static void release_slot(size_t slot);
+static struct swap_cache_entry *cache_find(size_t slot);
+static void trigger_read_ahead(size_t slot);
+static void read_ahead_daemon(void *aux UNUSED);
 
 
 /* swap pool init */
-void swap_pool_init() {
-	lock_init(&swap_space_pool_lock);
-	list_init(&swap_space_pool);
+void swap_pool_init(void) {
+	lock_init(&swap_lock);
+	next_slot = 0;
 
 	swap_block = block_get_role (BLOCK_SWAP);
-	uint32_t swap_pool_size = block_size(swap_block);
-	uint32_t i;
-	struct swap_page_block *spb = NULL;
-	/* populate the whole swap pool */
-	lock_acquire(&swap_space_pool_lock);
-	for (i = 0; i < swap_pool_size; i = i+BLOCKS_UNIT_NUMBER) {
-		spb = malloc(sizeof(struct swap_page_block));
-		spb->block_sector_head = (block_sector_t)i;
-		list_push_back(&swap_space_pool, &spb->elem);
-	}
-	lock_release(&swap_space_pool_lock);
-}
+	if (swap_block == NULL) {
+		/*run without swap, eviction fails for anonymous pages*/
+		return;
+	}
+	/*only whole pages are used*/
+	size_t slot_cnt = block_size(swap_block) / BLOCKS_UNIT_NUMBER;
+	used_slots = bitmap_create(slot_cnt);
+	writing_slots = bitmap_create(slot_cnt);
+	slot_refs = calloc(slot_cnt, sizeof *slot_refs);
+	if (used_slots == NULL || writing_slots == NULL || slot_refs == NULL) {
+		PANIC ("fail to allocate swap table");
+	}
 
-/* retrieve a free swap_page_block from the swap pool*/
-struct swap_page_block *get_free_spb() {
-	lock_acquire(&swap_space_pool_lock);
-	if (list_empty(&swap_space_pool)) {
-		lock_release(&swap_space_pool_lock);
-		PANIC("NO FREE SWAP BLOCK");
-	}
-	struct swap_page_block *result =
-			list_entry(list_pop_front(&swap_space_pool),
-					struct swap_page_block, elem);
-	lock_release(&swap_space_pool_lock);
-	return result;
+	int i;
+	for (i = 0; i < SWAP_CACHE_SIZE; i++) {
+		swap_cache[i].state = SC_EMPTY;
+		swap_cache[i].stale = false;
+		swap_cache[i].page = palloc_get_page(PAL_ASSERT);
+	}
+	cache_hand = 0;
+	cond_init(&read_ahead_queued);
+	cond_init(&read_ahead_done);
+	/*create read-ahead daemon thread*/
+	tid_t t = thread_create("swap_read_ahead_daemon", PRI_DEFAULT,
+			read_ahead_daemon, NULL);
+	if (t == TID_ERROR) {
+		PANIC ("fail to create swap read-ahead daemon");
+	}
 }
 
-/* put the swap_page_block back into the swap pool */
-void put_back_spb(struct swap_page_block *spb) {
-	lock_acquire(&swap_space_pool_lock);
-	list_push_back(&swap_space_pool, &spb->elem);
-	lock_release(&swap_space_pool_lock);
+/* take a free slot for REF_CNT pages, HINT if it is free and otherwise
+ * the next free one after the last taken. the slot is marked as being
+ * written until swap_out is done with it. returns SWAP_SLOT_NONE if
+ * the swap space is used up */
+static size_t alloc_slot(size_t hint, int ref_cnt) {
+	size_t slot = SWAP_SLOT_NONE;
+	lock_acquire(&swap_lock);
+	if (hint < bitmap_size(used_slots) && !bitmap_test(used_slots, hint)) {
+		bitmap_mark(used_slots, hint);
+		slot = hint;
+	} else {
+		slot = bitmap_scan_and_flip(used_slots, next_slot, 1, false);
+		if (slot == BITMAP_ERROR) {
+			slot = bitmap_scan_and_flip(used_slots, 0, 1, false);
+		}
+	}
+	if (slot != BITMAP_ERROR) {
+		slot_refs[slot] = ref_cnt;
+		bitmap_mark(writing_slots, slot);
+		next_slot = slot + 1;
+	}
+	lock_release(&swap_lock);
+	return slot == BITMAP_ERROR ? SWAP_SLOT_NONE : slot;
 }
 
+/* take another reference to SLOT, for a forked child's copy of a page
+ * in swap */
+size_t swap_dup(size_t slot) {
+	lock_acquire(&swap_lock);
+	ASSERT(slot_refs[slot] > 0 && slot_refs[slot] < UINT16_MAX);
+	slot_refs[slot]++;
+	lock_release(&swap_lock);
+	return slot;
+}
 
-/* swap in */
-void swap_in(struct frame_table_entry *fte, struct swap_page_block *spb) {
-	struct supplemental_pte *spte = fte->spte;
-
-	/* indicate the spte is not swapped */
-	spte->spb = NULL;
+/* drop a reference to SLOT, freeing it with the last one */
+void swap_free(size_t slot) {
+	lock_acquire(&swap_lock);
+	release_slot(slot);
+	lock_release(&swap_lock);
+}
 
-	uint32_t i;
-	fte->accessed = true;
-	for (i = 0; i < BLOCKS_UNIT_NUMBER; i++) {
-		block_read(swap_block, i+spb->block_sector_head,
-				(void *)(fte->frame_addr+i*BLOCK_SECTOR_SIZE));
+/* drop a reference to SLOT, must hold swap_lock. with the last one
+ * the slot is freed, and its read-ahead copy with it */
+static void release_slot(size_t slot) {
+	ASSERT(lock_held_by_current_thread(&swap_lock));
+	ASSERT(slot_refs[slot] > 0);
+	if (--slot_refs[slot] > 0) {
+		return;
+	}
+	bitmap_reset(used_slots, slot);
+	struct swap_cache_entry *e = cache_find(slot);
+	if (e != NULL) {
+		if (e->state == SC_LOADING) {
+			/*the daemon drops it when the read is done*/
+			e->stale = true;
+		} else {
+			e->state = SC_EMPTY;
+		}
 	}
-	/* put the swap_page_block back into the swap pool */
-	put_back_spb(spb);
 }
 
 
+/* swap in the page at SLOT into the frame at FRAME_ADDR, and drop
+ * the caller's reference to the slot. the page is copied from the
+ * swap cache if it was read ahead, and the slots after it, which
+ * usually hold the pages evicted along with it, are read ahead */
+void swap_in(void *frame_addr, size_t slot) {
+	lock_acquire(&swap_lock);
+	struct swap_cache_entry *e;
+	/*wait for a read already going on rather than start another*/
+	while ((e = cache_find(slot)) != NULL && e->state == SC_LOADING) {
+		cond_wait(&read_ahead_done, &swap_lock);
+	}
+	bool cached = e != NULL && e->state == SC_READY;
+	if (cached) {
+		memcpy(frame_addr, e->page, PGSIZE);
+	} else if (e != NULL) {
+		/*still queued, read it here instead*/
+		e->state = SC_EMPTY;
+	}
+	lock_release(&swap_lock);
 
+	if (!cached) {
+		block_read_multiple(swap_block, slot * BLOCKS_UNIT_NUMBER,
+				BLOCKS_UNIT_NUMBER, frame_addr);
+	}
 
+	lock_acquire(&swap_lock);
+	trigger_read_ahead(slot);
+	/* the slot is freed with its last page */
+	release_slot(slot);
+	lock_release(&swap_lock);
+}
 
-/* swap out */
-void swap_out(struct frame_table_entry *fte) {
-	/* retrieve a free swap_page_block from the swap pool*/
-	struct swap_page_block *spb = get_free_spb();
-	struct supplemental_pte *spte = fte->spte;
-	/* indicate the spte is swapped */
-	spte->spb = spb;
-	uint32_t i;
-	fte->accessed = true;
-	for (i = 0; i < BLOCKS_UNIT_NUMBER; i++) {
-		block_write(swap_block, i+spb->block_sector_head,
-				(void *)(fte->frame_addr+i*BLOCK_SECTOR_SIZE));
+/* swap out the frame at FRAME_ADDR, shared by REF_CNT pages, into
+ * the slot HINT if it is free, so that neighbor pages stay together,
+ * or any other. returns the slot or SWAP_SLOT_NONE if there is no
+ * free swap slot */
+size_t swap_out(const void *frame_addr, int ref_cnt, size_t hint) {
+	ASSERT(ref_cnt > 0 && ref_cnt <= UINT16_MAX);
+	if (swap_block == NULL) {
+		return SWAP_SLOT_NONE;
+	}
+	size_t slot = alloc_slot(hint, ref_cnt);
+	if (slot == SWAP_SLOT_NONE) {
+		return SWAP_SLOT_NONE;
 	}
+	block_write_multiple(swap_block, slot * BLOCKS_UNIT_NUMBER,
+			BLOCKS_UNIT_NUMBER, frame_addr);
+
+	/*read-ahead skips the slot while it is written, drop anything it
+	 * got for it anyway, which holds what was on disk before*/
+	lock_acquire(&swap_lock);
+	bitmap_reset(writing_slots, slot);
+	struct swap_cache_entry *e = cache_find(slot);
+	if (e != NULL) {
+		if (e->state == SC_LOADING) {
+			e->stale = true;
+		} else {
+			e->state = SC_EMPTY;
+		}
+	}
+	lock_release(&swap_lock);
+	return slot;
 }
 
+/* the swap cache entry holding or loading SLOT, NULL if there is
+ * none. must hold swap_lock */
+static struct swap_cache_entry *cache_find(size_t slot) {
+	ASSERT(lock_held_by_current_thread(&swap_lock));
+	int i;
+	for (i = 0; i < SWAP_CACHE_SIZE; i++) {
+		if (swap_cache[i].state != SC_EMPTY && !swap_cache[i].stale
+				&& swap_cache[i].slot == slot) {
+			return &swap_cache[i];
+		}
+	}
+	return NULL;
+}
 
+/* queue the used slots right after SLOT, up to SWAP_READ_AHEAD of
+ * them, for the read-ahead daemon. it stops at a slot swap_out is
+ * still writing, whose data is not on disk yet. entries are taken
+ * round robin from those that are empty or loaded already, a full
+ * cache of pending reads is left alone. must hold swap_lock */
+static void trigger_read_ahead(size_t slot) {
+	ASSERT(lock_held_by_current_thread(&swap_lock));
+	size_t s;
+	int i;
+	for (s = slot + 1; s <= slot + SWAP_READ_AHEAD
+			&& s < bitmap_size(used_slots) && bitmap_test(used_slots, s)
+			&& !bitmap_test(writing_slots, s);
+			s++) {
+		if (cache_find(s) != NULL) {
+			continue;
+		}
+		struct swap_cache_entry *e = NULL;
+		for (i = 0; i < SWAP_CACHE_SIZE && e == NULL; i++) {
+			struct swap_cache_entry *c = &swap_cache[cache_hand];
+			cache_hand = (cache_hand + 1) % SWAP_CACHE_SIZE;
+			if (c->state == SC_EMPTY || c->state == SC_READY) {
+				e = c;
+			}
+		}
+		if (e == NULL) {
+			return;
+		}
+		e->slot = s;
+		e->state = SC_QUEUED;
+		cond_signal(&read_ahead_queued, &swap_lock);
+	}
+}
 
-
-
-
-
-
-
-
-
-
-
-
-
-
+/* read-ahead daemon, reads the queued slots into the swap cache */
+static void read_ahead_daemon(void *aux UNUSED) {
+	int i;
+	lock_acquire(&swap_lock);
+	while (true) {
+		struct swap_cache_entry *e = NULL;
+		for (i = 0; i < SWAP_CACHE_SIZE && e == NULL; i++) {
+			if (swap_cache[i].state == SC_QUEUED) {
+				e = &swap_cache[i];
+			}
+		}
+		if (e == NULL) {
+			cond_wait(&read_ahead_queued, &swap_lock);
+			continue;
+		}
+		/*the slot stays used while it is read, or the entry goes
+		 * stale and is dropped*/
+		e->state = SC_LOADING;
+		lock_release(&swap_lock);
+		block_read_multiple(swap_block, e->slot * BLOCKS_UNIT_NUMBER,
+				BLOCKS_UNIT_NUMBER, e->page);
+		lock_acquire(&swap_lock);
+		if (e->stale) {
+			e->stale = false;
+			e->state = SC_EMPTY;
+		} else {
+			e->state = SC_READY;
+		}
+		cond_broadcast(&read_ahead_done, &swap_lock);
+	}
+}
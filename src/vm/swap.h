@@ -2,20 +2,15 @@
 #define VM_SWAP_H
 
 #include "devices/block.h"
+#include <stddef.h>
 #include <stdint.h>
-#include <list.h>
-#include "vm/page.h"
-#include "vm/frame.h"
-
-void swap_pool_init();
-void swap_out(struct frame_table_entry *fte);
-void swap_in(struct frame_table_entry *fte, struct swap_page_block *spb);
-
-struct swap_page_block {
-	block_sector_t block_sector_head;  /*starting block sector in disk*/
-	struct list_elem elem;             /*list elem of list swap_space_pool*/
-};
 
+#define SWAP_SLOT_NONE SIZE_MAX   /*no swap slot*/
 
+void swap_pool_init(void);
+size_t swap_out(const void *frame_addr, int ref_cnt, size_t hint);
+void swap_in(void *frame_addr, size_t slot);
+size_t swap_dup(size_t slot);
+void swap_free(size_t slot);
 
 #endif /* vm/swap.h */